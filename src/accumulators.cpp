@@ -0,0 +1,205 @@
+#include "accumulators.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "checkpoint.h"
+
+RunningStats::RunningStats()
+: n(0), mu(0.0), m2(0.0), lo(HUGE_VAL), hi(-HUGE_VAL) {}
+
+void RunningStats::add(double x) {
+    n++;
+    double delta = x - mu;
+    mu += delta / n;
+    m2 += delta * (x - mu);
+    lo = std::min(lo, x);
+    hi = std::max(hi, x);
+}
+
+void RunningStats::merge(const RunningStats &other) {
+    if (other.n == 0)
+        return;
+    if (n == 0) {
+        *this = other;
+        return;
+    }
+    uint64_t total = n + other.n;
+    double delta = other.mu - mu;
+    mu += delta * other.n / total;
+    m2 += other.m2 + delta * delta * ((double)n * other.n / total);
+    n = total;
+    lo = std::min(lo, other.lo);
+    hi = std::max(hi, other.hi);
+}
+
+void RunningStats::save(CheckpointWriter &out) const {
+    out.put<uint64_t>(n);
+    out.put<double>(mu);
+    out.put<double>(m2);
+    out.put<double>(lo);
+    out.put<double>(hi);
+}
+
+void RunningStats::load(CheckpointReader &in) {
+    n = in.get<uint64_t>();
+    mu = in.get<double>();
+    m2 = in.get<double>();
+    lo = in.get<double>();
+    hi = in.get<double>();
+}
+
+double RunningStats::stddev() const { return std::sqrt(variance()); }
+
+double RunningStats::standardError() const {
+    return n > 1 ? std::sqrt(variance() / n) : 0.0;
+}
+
+BinningAnalysis::BinningAnalysis() {
+    std::fill(pending, pending + MAX_LEVELS, 0.0);
+    std::fill(hasPending, hasPending + MAX_LEVELS, false);
+}
+
+void BinningAnalysis::add(double x) {
+    // Carry pairs upwards like a binary counter: amortized O(1) per sample.
+    for (int k = 0; k < MAX_LEVELS; k++) {
+        level[k].add(x);
+        if (!hasPending[k]) {
+            pending[k] = x;
+            hasPending[k] = true;
+            return;
+        }
+        x = 0.5 * (pending[k] + x);
+        hasPending[k] = false;
+    }
+}
+
+void BinningAnalysis::save(CheckpointWriter &out) const {
+    for (int k = 0; k < MAX_LEVELS; k++) {
+        level[k].save(out);
+        out.put<double>(pending[k]);
+        out.put<uint8_t>(hasPending[k] ? 1 : 0);
+    }
+}
+
+void BinningAnalysis::load(CheckpointReader &in) {
+    for (int k = 0; k < MAX_LEVELS; k++) {
+        level[k].load(in);
+        pending[k] = in.get<double>();
+        hasPending[k] = in.get<uint8_t>() != 0;
+    }
+}
+
+int BinningAnalysis::levels() const {
+    int k = 0;
+    while (k < MAX_LEVELS && level[k].count() >= (uint64_t)MIN_BLOCKS) {
+        k++;
+    }
+    return k;
+}
+
+double BinningAnalysis::error() const {
+    int k = levels();
+    return k > 0 ? error(k - 1) : error(0);
+}
+
+double BinningAnalysis::autocorrelationTime() const {
+    double base = error(0);
+    if (base <= 0)
+        return 0.0;
+    double ratio = error() / base;
+    return std::max(0.0, 0.5 * (ratio * ratio - 1.0));
+}
+
+StreamingHistogram::StreamingHistogram(int bins, double lo, double hi)
+: numBins(bins), lo(lo), hi(hi), scale(bins / (hi - lo)), counts(bins, 0.0),
+under(0.0), over(0.0) {}
+
+void StreamingHistogram::merge(const StreamingHistogram &other, double weight) {
+    for (int b = 0; b < numBins; b++) {
+        counts[b] += weight * other.counts[b];
+    }
+    under += weight * other.under;
+    over += weight * other.over;
+}
+
+void StreamingHistogram::rescale(double factor) {
+    for (int b = 0; b < numBins; b++) {
+        counts[b] *= factor;
+    }
+    under *= factor;
+    over *= factor;
+}
+
+void StreamingHistogram::clear() {
+    std::fill(counts.begin(), counts.end(), 0.0);
+    under = 0.0;
+    over = 0.0;
+}
+
+void StreamingHistogram::save(CheckpointWriter &out) const {
+    out.putDoubles(counts);
+    out.put<double>(under);
+    out.put<double>(over);
+}
+
+void StreamingHistogram::load(CheckpointReader &in) {
+    in.getDoubles(counts);
+    under = in.get<double>();
+    over = in.get<double>();
+}
+
+double StreamingHistogram::total() const {
+    double sum = under + over;
+    for (int b = 0; b < numBins; b++) {
+        sum += counts[b];
+    }
+    return sum;
+}
+
+double StreamingHistogram::density(int b) const {
+    double sum = total();
+    return sum > 0 ? counts[b] / (sum * binWidth()) : 0.0;
+}
+
+ComplexSum::ComplexSum()
+: n(0), re(0.0), reCompensation(0.0), im(0.0), imCompensation(0.0) {}
+
+static void neumaierAdd(double &sum, double &compensation, double x) {
+    double t = sum + x;
+    if (std::fabs(sum) >= std::fabs(x))
+        compensation += (sum - t) + x;
+    else
+        compensation += (x - t) + sum;
+    sum = t;
+}
+
+void ComplexSum::add(const std::complex<double> &z) {
+    neumaierAdd(re, reCompensation, z.real());
+    neumaierAdd(im, imCompensation, z.imag());
+    n++;
+}
+
+void ComplexSum::merge(const ComplexSum &other) {
+    neumaierAdd(re, reCompensation, other.re);
+    neumaierAdd(re, reCompensation, other.reCompensation);
+    neumaierAdd(im, imCompensation, other.im);
+    neumaierAdd(im, imCompensation, other.imCompensation);
+    n += other.n;
+}
+
+void ComplexSum::save(CheckpointWriter &out) const {
+    out.put<uint64_t>(n);
+    out.put<double>(re);
+    out.put<double>(reCompensation);
+    out.put<double>(im);
+    out.put<double>(imCompensation);
+}
+
+void ComplexSum::load(CheckpointReader &in) {
+    n = in.get<uint64_t>();
+    re = in.get<double>();
+    reCompensation = in.get<double>();
+    im = in.get<double>();
+    imCompensation = in.get<double>();
+}
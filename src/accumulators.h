@@ -0,0 +1,136 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+class CheckpointReader;
+class CheckpointWriter;
+
+// Constant-memory accumulators that consume samples as they are produced.
+// Each has merge() so per-thread or per-batch partials can be reduced in a
+// fixed order, and save/load so a run can be checkpointed and resumed.
+
+// Welford's running mean and variance, with Chan's pairwise update for merge.
+class RunningStats {
+public:
+    RunningStats();
+
+    void add(double x);
+    void merge(const RunningStats &other);
+
+    void save(CheckpointWriter &out) const;
+    void load(CheckpointReader &in);
+
+    uint64_t count() const { return n; }
+    double mean() const { return mu; }
+    double variance() const { return n > 1 ? m2 / (n - 1) : 0.0; }
+    double stddev() const;
+    // Error of the mean, valid for uncorrelated samples only.
+    double standardError() const;
+    double min() const { return lo; }
+    double max() const { return hi; }
+
+private:
+    uint64_t n;
+    double mu;
+    double m2;
+    double lo;
+    double hi;
+};
+
+// Binning analysis of a correlated stream. Level k keeps running stats of the
+// means of 2^k consecutive samples, so the naive error at level k grows until
+// the blocks outlast the autocorrelation and then levels off:
+//   tau_int = (error_k^2 / error_0^2 - 1) / 2
+class BinningAnalysis {
+public:
+    static const int MAX_LEVELS = 40;
+    // Levels with fewer blocks than this are too noisy to report.
+    static const int MIN_BLOCKS = 32;
+
+    BinningAnalysis();
+
+    void add(double x);
+
+    void save(CheckpointWriter &out) const;
+    void load(CheckpointReader &in);
+
+    uint64_t count() const { return level[0].count(); }
+    double mean() const { return level[0].mean(); }
+    int levels() const;
+    double error(int k) const { return level[k].standardError(); }
+    // Error and autocorrelation time at the deepest reliable level.
+    double error() const;
+    double autocorrelationTime() const;
+
+private:
+    RunningStats level[MAX_LEVELS];
+    double pending[MAX_LEVELS];
+    bool hasPending[MAX_LEVELS];
+};
+
+// Fixed-range weighted histogram; samples outside [lo, hi) only count towards
+// underflow/overflow.
+class StreamingHistogram {
+public:
+    StreamingHistogram(int bins = 100, double lo = -4.0, double hi = 4.0);
+
+    void add(double x, double weight = 1.0) {
+        if (x < lo) {
+            under += weight;
+        } else if (x >= hi) {
+            over += weight;
+        } else {
+            int b = (int)((x - lo) * scale);
+            counts[b < numBins ? b : numBins - 1] += weight;
+        }
+    }
+
+    void merge(const StreamingHistogram &other, double weight = 1.0);
+    void rescale(double factor);
+    void clear();
+
+    void save(CheckpointWriter &out) const;
+    void load(CheckpointReader &in);
+
+    int bins() const { return numBins; }
+    double binWidth() const { return (hi - lo) / numBins; }
+    double binCenter(int b) const { return lo + (b + 0.5) * binWidth(); }
+    double count(int b) const { return counts[b]; }
+    double underflow() const { return under; }
+    double overflow() const { return over; }
+    double total() const;
+    // count / (total * binWidth), so the density integrates to the fraction
+    // of samples in range.
+    double density(int b) const;
+
+private:
+    int numBins;
+    double lo, hi, scale;
+    std::vector<double> counts;
+    double under, over;
+};
+
+// Neumaier-compensated complex sum. Adding 10^9 unit phasors naively loses
+// most of the digits of a nearly cancelling total.
+class ComplexSum {
+public:
+    ComplexSum();
+
+    void add(const std::complex<double> &z);
+    void merge(const ComplexSum &other);
+
+    void save(CheckpointWriter &out) const;
+    void load(CheckpointReader &in);
+
+    uint64_t count() const { return n; }
+    std::complex<double> value() const {
+        return std::complex<double>(re + reCompensation, im + imCompensation);
+    }
+
+private:
+    uint64_t n;
+    double re, reCompensation;
+    double im, imCompensation;
+};
@@ -0,0 +1,124 @@
+#include "action_kernel.h"
+#include "action_kernel_impl.h"
+
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+const ActionKernel &scalarActionKernel() {
+    static const ActionKernel kernel = {SIMD_SCALAR, "scalar",
+                                        actionRowsFor<ScalarVec>,
+                                        phaseRows<ScalarVec>,
+                                        gaussianPairRows<ScalarVec>,
+                                        gradientRowsFor<ScalarVec>};
+    return kernel;
+}
+
+SimdLevel detectSimdLevel() {
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+(defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SIMD_SSE2;
+    return SIMD_SCALAR;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || maxLeaf < 7)
+        return sse2 ? SIMD_SSE2 : SIMD_SCALAR;
+
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+    bool avx512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+    if (avx512)
+        return SIMD_AVX512;
+    if (avx2)
+        return SIMD_AVX2;
+    return sse2 ? SIMD_SSE2 : SIMD_SCALAR;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+static const ActionKernel *compiledKernel(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX512:
+            return avx512ActionKernel();
+        case SIMD_AVX2:
+            return avx2ActionKernel();
+        case SIMD_SSE2:
+            return sse2ActionKernel();
+        case SIMD_SCALAR:
+            return &scalarActionKernel();
+    }
+    return &scalarActionKernel();
+}
+
+static const ActionKernel *bestKernel(SimdLevel limit) {
+    SimdLevel supported = detectSimdLevel();
+    int level = limit < supported ? limit : supported;
+    for (; level > SIMD_SCALAR; level--) {
+        const ActionKernel *kernel = compiledKernel((SimdLevel)level);
+        if (kernel)
+            return kernel;
+    }
+    return &scalarActionKernel();
+}
+
+static const ActionKernel *activeKernel = nullptr;
+
+const ActionKernel &actionKernel() {
+    if (!activeKernel)
+        activeKernel = bestKernel(SIMD_AVX512);
+    return *activeKernel;
+}
+
+SimdLevel setSimdLevel(SimdLevel level) {
+    activeKernel = bestKernel(level);
+    return activeKernel->level;
+}
+
+const char *simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX512:
+            return "avx512";
+        case SIMD_AVX2:
+            return "avx2";
+        case SIMD_SSE2:
+            return "sse2";
+        case SIMD_SCALAR:
+            return "scalar";
+    }
+    return "scalar";
+}
+
+bool parseSimdLevel(const char *name, SimdLevel &level) {
+    for (int i = SIMD_SCALAR; i <= SIMD_AVX512; i++) {
+        if (std::strcmp(name, simdLevelName((SimdLevel)i)) == 0) {
+            level = (SimdLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void evaluateEnsemble(PathEnsemble &paths, double mass, double dt,
+                      double hbar, const Potential &potential) {
+    const ActionKernel &kernel = actionKernel();
+    kernel.computeActions(paths.positions(), paths.stride(), paths.numPaths(),
+                          paths.numSites(), makeActionCoefficients(mass, dt),
+                          potential, paths.actions());
+    kernel.computePhases(paths.actions(), paths.numPaths(), 1.0 / hbar,
+                         paths.amplitudesRe(), paths.amplitudesIm());
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+
+#include "path_ensemble.h"
+#include "potential.h"
+
+enum SimdLevel { SIMD_SCALAR = 0, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512 };
+
+// Discretized real-time action S = sum_t [kinetic * (x_t - x_{t-1})^2
+// - potential * V(x_t)], i.e. kinetic = m / (2 dt) and potential = dt.
+struct ActionCoefficients {
+    double kinetic;
+    double potential;
+};
+
+inline ActionCoefficients makeActionCoefficients(double mass, double dt) {
+    ActionCoefficients c;
+    c.kinetic = 0.5 * mass / dt;
+    c.potential = dt;
+    return c;
+}
+
+// Imaginary-time action S_E = sum_t [m/(2 dt) (x_t - x_{t-1})^2 + dt V(x_t)]
+// through the same kernels.
+inline ActionCoefficients makeEuclideanCoefficients(double mass, double dt) {
+    ActionCoefficients c;
+    c.kinetic = 0.5 * mass / dt;
+    c.potential = -dt;
+    return c;
+}
+
+typedef void (*ActionRowsFn)(const double *positions, size_t stride,
+                             int numPaths, int numSites,
+                             const ActionCoefficients &coefficients,
+                             const Potential &potential, double *actions);
+
+// re + i im = exp(-i * scale * action) for each entry.
+typedef void (*PhasesFn)(const double *actions, int count, double scale,
+                         double *re, double *im);
+
+// Box-Muller on pre-split uniforms: u1 = mantissa * 2^exponent with mantissa
+// in [sqrt(1/2), sqrt(2)), u2 = turns in [0, 1). Writes
+// r cos(2 pi u2) and r sin(2 pi u2), r = sqrt(-2 ln u1), for each entry.
+typedef void (*GaussianPairsFn)(const double *mantissa, const double *exponent,
+                                const double *turns, int count,
+                                double *cosOut, double *sinOut);
+
+// Derivative of the same action with respect to each position,
+// gradient[t] = 2 kinetic (2 x_t - x_{t-1} - x_{t+1}) - potential * V'(x_t),
+// for t in [begin, end). Reads x[begin - 1] through x[end].
+typedef void (*ActionGradientFn)(const double *positions, int begin, int end,
+                                 const ActionCoefficients &coefficients,
+                                 const Potential &potential, double *gradient);
+
+struct ActionKernel {
+    SimdLevel level;
+    const char *name;
+    ActionRowsFn computeActions;
+    PhasesFn computePhases;
+    GaussianPairsFn gaussianPairs;
+    ActionGradientFn actionGradient;
+};
+
+const ActionKernel &scalarActionKernel();
+const ActionKernel *sse2ActionKernel();
+const ActionKernel *avx2ActionKernel();
+const ActionKernel *avx512ActionKernel();
+
+SimdLevel detectSimdLevel();
+
+// Kernel used by the simulation; defaults to the best level supported by
+// both the build and the running CPU.
+const ActionKernel &actionKernel();
+
+// Forces a lower level (for validation and benchmarking). Requests above
+// what is available are clamped; returns the level actually selected.
+SimdLevel setSimdLevel(SimdLevel level);
+
+const char *simdLevelName(SimdLevel level);
+bool parseSimdLevel(const char *name, SimdLevel &level);
+
+// Fills actions and unnormalized amplitudes exp(-iS/hbar) for every path.
+void evaluateEnsemble(PathEnsemble &paths, double mass, double dt,
+                      double hbar, const Potential &potential = Potential());
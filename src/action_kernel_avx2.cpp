@@ -0,0 +1,18 @@
+#include "action_kernel_impl.h"
+
+#if defined(__AVX2__)
+
+const ActionKernel *avx2ActionKernel() {
+    static const ActionKernel kernel = {SIMD_AVX2, "avx2",
+                                        actionRowsFor<Avx2Vec>,
+                                        phaseRows<Avx2Vec>,
+                                        gaussianPairRows<Avx2Vec>,
+                                        gradientRowsFor<Avx2Vec>};
+    return &kernel;
+}
+
+#else
+
+const ActionKernel *avx2ActionKernel() { return nullptr; }
+
+#endif
@@ -0,0 +1,18 @@
+#include "action_kernel_impl.h"
+
+#if defined(__AVX512F__)
+
+const ActionKernel *avx512ActionKernel() {
+    static const ActionKernel kernel = {SIMD_AVX512, "avx512",
+                                        actionRowsFor<Avx512Vec>,
+                                        phaseRows<Avx512Vec>,
+                                        gaussianPairRows<Avx512Vec>,
+                                        gradientRowsFor<Avx512Vec>};
+    return &kernel;
+}
+
+#else
+
+const ActionKernel *avx512ActionKernel() { return nullptr; }
+
+#endif
@@ -0,0 +1,361 @@
+#pragma once
+
+// Kernel bodies shared by the per-ISA translation units. Include after
+// simd.h; instantiate with one of its vector wrappers.
+
+#include <cmath>
+
+#include "action_kernel.h"
+#include "simd.h"
+
+namespace {
+
+// Potential functors for actionRows and gradientRows: operator() is V and
+// derivative() is V'. The polynomial ones are evaluated in SIMD registers;
+// the rest run their scalar formula per lane, still inlined into the
+// specialized loop.
+struct HarmonicPotential {
+    double k, half;
+    explicit HarmonicPotential(const Potential &p) : k(p.a), half(0.5 * p.a) {}
+
+    template <typename Vec> Vec operator()(const Vec &x) const {
+        return Vec(half) * x * x;
+    }
+    template <typename Vec> Vec derivative(const Vec &x) const {
+        return Vec(k) * x;
+    }
+};
+
+struct AnharmonicPotential {
+    double lambda;
+    explicit AnharmonicPotential(const Potential &p) : lambda(p.a) {}
+
+    template <typename Vec> Vec operator()(const Vec &x) const {
+        const Vec x2 = x * x;
+        return x2 * (Vec(0.5) + Vec(lambda) * x2);
+    }
+    template <typename Vec> Vec derivative(const Vec &x) const {
+        return x * (Vec(1.0) + Vec(4.0 * lambda) * x * x);
+    }
+};
+
+struct DoubleWellPotential {
+    double lambda, minimum2;
+    explicit DoubleWellPotential(const Potential &p)
+    : lambda(p.a), minimum2(p.b * p.b) {}
+
+    template <typename Vec> Vec operator()(const Vec &x) const {
+        const Vec d = x * x - Vec(minimum2);
+        return Vec(lambda) * d * d;
+    }
+    template <typename Vec> Vec derivative(const Vec &x) const {
+        return Vec(4.0 * lambda) * x * (x * x - Vec(minimum2));
+    }
+};
+
+struct SquareWellScalar {
+    double halfWidth, height;
+    explicit SquareWellScalar(const Potential &p)
+    : halfWidth(p.a), height(p.b) {}
+
+    double operator()(double x) const {
+        return std::fabs(x) < halfWidth ? 0.0 : height;
+    }
+    double derivative(double) const { return 0.0; }
+};
+
+struct MorseScalar {
+    double depth, alpha, center;
+    explicit MorseScalar(const Potential &p)
+    : depth(p.a), alpha(p.b), center(p.c) {}
+
+    double operator()(double x) const {
+        double e = 1.0 - std::exp(-alpha * (x - center));
+        return depth * e * e;
+    }
+    double derivative(double x) const {
+        double e = std::exp(-alpha * (x - center));
+        return 2.0 * depth * alpha * e * (1.0 - e);
+    }
+};
+
+struct TableScalar {
+    const PotentialTable *table;
+    explicit TableScalar(const Potential &p) : table(p.table.get()) {}
+
+    double operator()(double x) const { return table ? table->value(x) : 0.0; }
+    double derivative(double x) const {
+        return table ? table->derivative(x) : 0.0;
+    }
+};
+
+template <typename Scalar> struct LanewisePotential {
+    Scalar f;
+    explicit LanewisePotential(const Potential &p) : f(p) {}
+
+    template <typename Vec> Vec operator()(const Vec &x) const {
+        double lanes[Vec::WIDTH];
+        x.storeu(lanes);
+        for (int i = 0; i < Vec::WIDTH; i++) {
+            lanes[i] = f(lanes[i]);
+        }
+        return Vec::loadu(lanes);
+    }
+    template <typename Vec> Vec derivative(const Vec &x) const {
+        double lanes[Vec::WIDTH];
+        x.storeu(lanes);
+        for (int i = 0; i < Vec::WIDTH; i++) {
+            lanes[i] = f.derivative(lanes[i]);
+        }
+        return Vec::loadu(lanes);
+    }
+};
+
+// Round to nearest for |x| < 2^51 without SSE4.1/AVX rounding instructions.
+template <typename Vec> inline Vec roundNearest(const Vec &x) {
+    const Vec magic(6755399441055744.0);
+    return (x + magic) - magic;
+}
+
+// Cephes-style sin/cos: Cody-Waite reduction by pi/2 followed by minimax
+// polynomials on [-pi/4, pi/4]. Quadrant fix-up is done arithmetically so
+// the same body works for every wrapper without mask types.
+template <typename Vec> inline void sinCos(const Vec &x, Vec &s, Vec &c) {
+    const Vec j = roundNearest(x * Vec(0.63661977236758134308));
+    Vec r = x - j * Vec(1.57079625129699707031);
+    r = r - j * Vec(7.54978941586159635336e-8);
+    r = r - j * Vec(5.39030285815811905290e-15);
+    const Vec z = r * r;
+
+    Vec ps = Vec(1.58962301576546568060e-10);
+    ps = ps * z + Vec(-2.50507477628578072866e-8);
+    ps = ps * z + Vec(2.75573136213857245213e-6);
+    ps = ps * z + Vec(-1.98412698295895385996e-4);
+    ps = ps * z + Vec(8.33333333332211858878e-3);
+    ps = ps * z + Vec(-1.66666666666666307295e-1);
+    const Vec sr = r + r * z * ps;
+
+    Vec pc = Vec(-1.13585365213876817300e-11);
+    pc = pc * z + Vec(2.08757008419747316778e-9);
+    pc = pc * z + Vec(-2.75573141792967388112e-7);
+    pc = pc * z + Vec(2.48015872888517045348e-5);
+    pc = pc * z + Vec(-1.38888888888730564116e-3);
+    pc = pc * z + Vec(4.16666666666665929218e-2);
+    const Vec cr = Vec(1.0) - Vec(0.5) * z + z * z * pc;
+
+    const Vec q = j - Vec(4.0) * roundNearest(j * Vec(0.25) - Vec(0.375));
+    const Vec hi = roundNearest(q * Vec(0.5) - Vec(0.25));
+    const Vec odd = q - Vec(2.0) * hi;
+    const Vec one(1.0), two(2.0);
+
+    s = (sr + odd * (cr - sr)) * (one - two * hi);
+    c = (cr + odd * (sr - cr)) * (one - two * (hi + odd - two * hi * odd));
+}
+
+// ln(m) for m in [sqrt(1/2), sqrt(2)) as 2 atanh(s), s = (m - 1) / (m + 1).
+// |s| < 0.172 there, so eleven odd terms reach double precision.
+template <typename Vec> inline Vec logReduced(const Vec &m) {
+    const Vec one(1.0);
+    const Vec s = (m - one) / (m + one);
+    const Vec z = s * s;
+
+    Vec p = Vec(1.0 / 21);
+    p = p * z + Vec(1.0 / 19);
+    p = p * z + Vec(1.0 / 17);
+    p = p * z + Vec(1.0 / 15);
+    p = p * z + Vec(1.0 / 13);
+    p = p * z + Vec(1.0 / 11);
+    p = p * z + Vec(1.0 / 9);
+    p = p * z + Vec(1.0 / 7);
+    p = p * z + Vec(1.0 / 5);
+    p = p * z + Vec(1.0 / 3);
+    p = p * z + one;
+    return Vec(2.0) * s * p;
+}
+
+template <typename Vec>
+inline void gaussianPair(const Vec &mantissa, const Vec &exponent,
+                         const Vec &turns, Vec &z0, Vec &z1) {
+    const Vec ln2(0.69314718055994530942), twoPi(6.28318530717958647693);
+    const Vec r = sqrt(Vec(-2.0) * (logReduced(mantissa) + exponent * ln2));
+    Vec s, c;
+    sinCos(turns * twoPi, s, c);
+    z0 = r * c;
+    z1 = r * s;
+}
+
+template <typename Vec>
+void gaussianPairRows(const double *mantissa, const double *exponent,
+                      const double *turns, int count, double *cosOut,
+                      double *sinOut) {
+    const int W = Vec::WIDTH;
+
+    int i = 0;
+    for (; i + W <= count; i += W) {
+        Vec z0, z1;
+        gaussianPair(Vec::loadu(mantissa + i), Vec::loadu(exponent + i),
+                     Vec::loadu(turns + i), z0, z1);
+        z0.storeu(cosOut + i);
+        z1.storeu(sinOut + i);
+    }
+    for (; i < count; i++) {
+        ScalarVec z0, z1;
+        gaussianPair(ScalarVec(mantissa[i]), ScalarVec(exponent[i]),
+                     ScalarVec(turns[i]), z0, z1);
+        cosOut[i] = z0.v;
+        sinOut[i] = z1.v;
+    }
+}
+
+template <typename Vec, typename Potential>
+void actionRows(const double *positions, size_t stride, int numPaths,
+                int numSites, const ActionCoefficients &coefficients,
+                const Potential &V, double *actions) {
+    const int W = Vec::WIDTH;
+    const Vec kinetic(coefficients.kinetic);
+    const Vec potential(coefficients.potential);
+
+    for (int p = 0; p < numPaths; p++) {
+        const double *x = positions + (size_t)p * stride;
+
+        Vec acc0(0.0), acc1(0.0);
+        int t = 1;
+        for (; t + 2 * W <= numSites; t += 2 * W) {
+            Vec x0 = Vec::loadu(x + t);
+            Vec d0 = x0 - Vec::loadu(x + t - 1);
+            acc0 = acc0 + kinetic * d0 * d0 - potential * V(x0);
+
+            Vec x1 = Vec::loadu(x + t + W);
+            Vec d1 = x1 - Vec::loadu(x + t + W - 1);
+            acc1 = acc1 + kinetic * d1 * d1 - potential * V(x1);
+        }
+        for (; t + W <= numSites; t += W) {
+            Vec x0 = Vec::loadu(x + t);
+            Vec d0 = x0 - Vec::loadu(x + t - 1);
+            acc0 = acc0 + kinetic * d0 * d0 - potential * V(x0);
+        }
+
+        double action = (acc0 + acc1).sum();
+        for (; t < numSites; t++) {
+            double d = x[t] - x[t - 1];
+            action += coefficients.kinetic * d * d -
+                      coefficients.potential * V(ScalarVec(x[t])).v;
+        }
+        actions[p] = action;
+    }
+}
+
+template <typename Vec, typename Potential>
+void gradientRows(const double *x, int begin, int end,
+                  const ActionCoefficients &coefficients, const Potential &V,
+                  double *gradient) {
+    const int W = Vec::WIDTH;
+    const Vec stiffness(2.0 * coefficients.kinetic);
+    const Vec potential(coefficients.potential);
+    const Vec two(2.0);
+
+    int t = begin;
+    for (; t + W <= end; t += W) {
+        Vec xt = Vec::loadu(x + t);
+        Vec bend = two * xt - Vec::loadu(x + t - 1) - Vec::loadu(x + t + 1);
+        (stiffness * bend - potential * V.derivative(xt)).storeu(gradient + t);
+    }
+    for (; t < end; t++) {
+        double bend = 2.0 * x[t] - x[t - 1] - x[t + 1];
+        gradient[t] = 2.0 * coefficients.kinetic * bend -
+                      coefficients.potential * V.derivative(ScalarVec(x[t])).v;
+    }
+}
+
+template <typename Vec>
+void phaseRows(const double *actions, int count, double scale, double *re,
+               double *im) {
+    const int W = Vec::WIDTH;
+    const Vec vscale(scale), zero(0.0);
+
+    int i = 0;
+    for (; i + W <= count; i += W) {
+        Vec s, c;
+        sinCos(Vec::loadu(actions + i) * vscale, s, c);
+        c.storeu(re + i);
+        (zero - s).storeu(im + i);
+    }
+    for (; i < count; i++) {
+        ScalarVec s, c;
+        sinCos(ScalarVec(actions[i] * scale), s, c);
+        re[i] = c.v;
+        im[i] = -s.v;
+    }
+}
+
+// ActionRowsFn entry point: picks the loop specialized for the potential.
+template <typename Vec>
+void actionRowsFor(const double *positions, size_t stride, int numPaths,
+                   int numSites, const ActionCoefficients &coefficients,
+                   const Potential &potential, double *actions) {
+    switch (potential.kind) {
+        case POTENTIAL_HARMONIC:
+            actionRows<Vec>(positions, stride, numPaths, numSites, coefficients,
+                            HarmonicPotential(potential), actions);
+            return;
+        case POTENTIAL_ANHARMONIC:
+            actionRows<Vec>(positions, stride, numPaths, numSites, coefficients,
+                            AnharmonicPotential(potential), actions);
+            return;
+        case POTENTIAL_DOUBLE_WELL:
+            actionRows<Vec>(positions, stride, numPaths, numSites, coefficients,
+                            DoubleWellPotential(potential), actions);
+            return;
+        case POTENTIAL_SQUARE_WELL:
+            actionRows<Vec>(positions, stride, numPaths, numSites, coefficients,
+                            LanewisePotential<SquareWellScalar>(potential),
+                            actions);
+            return;
+        case POTENTIAL_MORSE:
+            actionRows<Vec>(positions, stride, numPaths, numSites, coefficients,
+                            LanewisePotential<MorseScalar>(potential), actions);
+            return;
+        case POTENTIAL_TABULATED:
+            actionRows<Vec>(positions, stride, numPaths, numSites, coefficients,
+                            LanewisePotential<TableScalar>(potential), actions);
+            return;
+    }
+}
+
+// ActionGradientFn entry point.
+template <typename Vec>
+void gradientRowsFor(const double *positions, int begin, int end,
+                     const ActionCoefficients &coefficients,
+                     const Potential &potential, double *gradient) {
+    switch (potential.kind) {
+        case POTENTIAL_HARMONIC:
+            gradientRows<Vec>(positions, begin, end, coefficients,
+                              HarmonicPotential(potential), gradient);
+            return;
+        case POTENTIAL_ANHARMONIC:
+            gradientRows<Vec>(positions, begin, end, coefficients,
+                              AnharmonicPotential(potential), gradient);
+            return;
+        case POTENTIAL_DOUBLE_WELL:
+            gradientRows<Vec>(positions, begin, end, coefficients,
+                              DoubleWellPotential(potential), gradient);
+            return;
+        case POTENTIAL_SQUARE_WELL:
+            gradientRows<Vec>(positions, begin, end, coefficients,
+                              LanewisePotential<SquareWellScalar>(potential),
+                              gradient);
+            return;
+        case POTENTIAL_MORSE:
+            gradientRows<Vec>(positions, begin, end, coefficients,
+                              LanewisePotential<MorseScalar>(potential),
+                              gradient);
+            return;
+        case POTENTIAL_TABULATED:
+            gradientRows<Vec>(positions, begin, end, coefficients,
+                              LanewisePotential<TableScalar>(potential),
+                              gradient);
+            return;
+    }
+}
+
+} // namespace
@@ -0,0 +1,18 @@
+#include "action_kernel_impl.h"
+
+#if defined(PI_HAVE_SSE2)
+
+const ActionKernel *sse2ActionKernel() {
+    static const ActionKernel kernel = {SIMD_SSE2, "sse2",
+                                        actionRowsFor<Sse2Vec>,
+                                        phaseRows<Sse2Vec>,
+                                        gaussianPairRows<Sse2Vec>,
+                                        gradientRowsFor<Sse2Vec>};
+    return &kernel;
+}
+
+#else
+
+const ActionKernel *sse2ActionKernel() { return nullptr; }
+
+#endif
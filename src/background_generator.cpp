@@ -0,0 +1,96 @@
+#include "background_generator.h"
+
+#include <utility>
+
+BackgroundGenerator::BackgroundGenerator(int numThreads)
+: generator(numThreads), hasResult(false), queuedStream(0), queued(false),
+running(false), stopping(false) {
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    worker = std::thread(&BackgroundGenerator::workerLoop, this);
+#endif
+}
+
+BackgroundGenerator::~BackgroundGenerator() {
+    if (!worker.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+void BackgroundGenerator::request(const SimulationParams &params,
+                                  uint64_t stream) {
+    if (!isAsync()) {
+        backSum = generator.generate(back, params, stream);
+        publish();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queuedParams = params;
+        queuedStream = stream;
+        queued = true;
+    }
+    wake.notify_one();
+}
+
+// Hands the back buffer over as the newest result; an uncollected older
+// result is simply overwritten.
+void BackgroundGenerator::publish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::swap(back, ready);
+    readySum = backSum;
+    hasResult = true;
+}
+
+bool BackgroundGenerator::collect(PathEnsemble &paths,
+                                  std::complex<double> &sum) {
+    if (!hasResult.load(std::memory_order_acquire))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::swap(paths, ready);
+    sum = readySum;
+    hasResult = false;
+    return true;
+}
+
+bool BackgroundGenerator::busy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queued || running;
+}
+
+void BackgroundGenerator::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return !queued && !running; });
+}
+
+void BackgroundGenerator::workerLoop() {
+    for (;;) {
+        SimulationParams params;
+        uint64_t stream;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || queued; });
+            if (stopping)
+                return;
+            params = queuedParams;
+            stream = queuedStream;
+            queued = false;
+            running = true;
+        }
+
+        backSum = generator.generate(back, params, stream);
+        publish();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        idle.notify_all();
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "path_ensemble.h"
+#include "path_generator.h"
+#include "simulation_params.h"
+
+// Regenerates ensembles on a dedicated thread so the caller (the viewers'
+// render loops) never waits for PathGenerator. Three ensembles rotate: the
+// worker fills a back buffer, publishes it as "ready", and collect() swaps it
+// with the caller's ensemble; every hand-off is an O(1) buffer swap, and the
+// grow-only buffers are reused from one generation to the next.
+//
+// Without thread support (Emscripten builds without pthreads) request()
+// generates synchronously and collect() behaves the same way.
+class BackgroundGenerator {
+public:
+    explicit BackgroundGenerator(int numThreads = 0);
+    ~BackgroundGenerator();
+
+    BackgroundGenerator(const BackgroundGenerator &) = delete;
+    BackgroundGenerator &operator=(const BackgroundGenerator &) = delete;
+
+    bool isAsync() const { return worker.joinable(); }
+    int numThreads() const { return generator.numThreads(); }
+
+    // Queues a regeneration. Requests made while the worker is busy are
+    // coalesced: only the most recent one runs next.
+    void request(const SimulationParams &params, uint64_t stream);
+
+    // If a finished ensemble is waiting, swaps it into paths, stores its
+    // amplitude sum (see PathGenerator::generate) and returns true. The
+    // caller's previous buffers are recycled by the worker.
+    bool collect(PathEnsemble &paths, std::complex<double> &sum);
+
+    // True while a request is queued or being generated.
+    bool busy() const;
+
+    // Blocks until every queued request has been generated.
+    void wait();
+
+private:
+    void workerLoop();
+    void publish();
+
+    PathGenerator generator;
+    PathEnsemble back;
+    PathEnsemble ready;
+    std::complex<double> backSum;
+    std::complex<double> readySum;
+    std::atomic<bool> hasResult;
+
+    SimulationParams queuedParams;
+    uint64_t queuedStream;
+    bool queued;
+    bool running;
+    bool stopping;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::thread worker;
+};
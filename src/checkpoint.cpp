@@ -0,0 +1,199 @@
+#include "checkpoint.h"
+
+#include <cstdio>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char CHECKPOINT_MAGIC[8] = {'Q', 'P', 'C', 'H', 'K', 'P', 'N', 'T'};
+static const uint32_t CHECKPOINT_VERSION = 5;
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+static const size_t CHECKPOINT_HEADER_BYTES = 16;
+
+static uint64_t fnv1a(const unsigned char *data, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+CheckpointWriter::CheckpointWriter() {
+    bytes.assign(CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + sizeof(CHECKPOINT_MAGIC));
+    put<uint32_t>(CHECKPOINT_VERSION);
+    put<uint32_t>(BYTE_ORDER_MARK);
+}
+
+void CheckpointWriter::putString(const std::string &value) {
+    put<uint64_t>(value.size());
+    bytes.insert(bytes.end(), value.begin(), value.end());
+}
+
+void CheckpointWriter::putDoubles(const std::vector<double> &values) {
+    put<uint64_t>(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        put<double>(values[i]);
+    }
+}
+
+std::vector<unsigned char> CheckpointWriter::serialize() const {
+    std::vector<unsigned char> data(bytes);
+    uint64_t hash = fnv1a(bytes.data(), bytes.size());
+    const unsigned char *hashBytes = (const unsigned char *)&hash;
+    data.insert(data.end(), hashBytes, hashBytes + sizeof(hash));
+    return data;
+}
+
+bool CheckpointWriter::commit(const std::string &path) {
+    const std::string staging = path + ".tmp";
+    std::FILE *file = std::fopen(staging.c_str(), "wb");
+    if (!file) {
+        lastError = "cannot open " + staging + " for writing";
+        return false;
+    }
+
+    std::vector<unsigned char> data = serialize();
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    ok = ok && std::fflush(file) == 0;
+#if defined(_WIN32)
+    ok = ok && _commit(_fileno(file)) == 0;
+#else
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::remove(staging.c_str());
+        lastError = "failed to write " + staging;
+        return false;
+    }
+
+#if defined(_WIN32)
+    ok = MoveFileExA(staging.c_str(), path.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    ok = std::rename(staging.c_str(), path.c_str()) == 0;
+#endif
+    if (!ok) {
+        lastError = "cannot replace " + path;
+        return false;
+    }
+    return true;
+}
+
+CheckpointReader::CheckpointReader() : offset(0), end(0), failed(true) {}
+
+bool CheckpointReader::open(const std::string &path) {
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        failed = true;
+        lastError = "cannot open " + path;
+        return false;
+    }
+    std::vector<unsigned char> data;
+    unsigned char block[1 << 16];
+    size_t count;
+    while ((count = std::fread(block, 1, sizeof(block), file)) > 0) {
+        data.insert(data.end(), block, block + count);
+    }
+    std::fclose(file);
+    return parse(data, path);
+}
+
+bool CheckpointReader::parse(std::vector<unsigned char> data,
+                             const std::string &name) {
+    bytes.swap(data);
+    offset = 0;
+    end = 0;
+    failed = true;
+
+    if (bytes.size() < CHECKPOINT_HEADER_BYTES + sizeof(uint64_t) ||
+        std::memcmp(bytes.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+        lastError = name + " is not a checkpoint";
+        return false;
+    }
+
+    end = bytes.size() - sizeof(uint64_t);
+    uint64_t hash;
+    std::memcpy(&hash, bytes.data() + end, sizeof(hash));
+    if (hash != fnv1a(bytes.data(), end)) {
+        lastError = name + " is corrupt";
+        return false;
+    }
+
+    failed = false;
+    offset = sizeof(CHECKPOINT_MAGIC);
+    if (get<uint32_t>() != CHECKPOINT_VERSION) {
+        failed = true;
+        lastError = name + " has an unsupported version";
+        return false;
+    }
+    if (get<uint32_t>() != BYTE_ORDER_MARK) {
+        failed = true;
+        lastError = name + " was written with a different byte order";
+        return false;
+    }
+    return true;
+}
+
+bool CheckpointReader::require(size_t count) {
+    if (failed || end - offset < count) {
+        if (!failed)
+            lastError = "checkpoint ends early";
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+std::string CheckpointReader::getString() {
+    uint64_t size = get<uint64_t>();
+    if (!require(size))
+        return std::string();
+    std::string value(bytes.begin() + offset, bytes.begin() + offset + size);
+    offset += size;
+    return value;
+}
+
+void CheckpointReader::getDoubles(std::vector<double> &values) {
+    uint64_t size = get<uint64_t>();
+    if (failed)
+        return;
+    if (size != values.size()) {
+        failed = true;
+        lastError = "checkpoint does not match the run configuration";
+        return;
+    }
+    if (!require(size * sizeof(double)))
+        return;
+    std::memcpy(values.data(), bytes.data() + offset, size * sizeof(double));
+    offset += size * sizeof(double);
+}
+
+bool truncateFile(const std::string &path, uint64_t bytes) {
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    bool ok = GetFileSizeEx(handle, &size) && (uint64_t)size.QuadPart >= bytes;
+    size.QuadPart = (LONGLONG)bytes;
+    ok = ok && SetFilePointerEx(handle, size, NULL, FILE_BEGIN) &&
+         SetEndOfFile(handle);
+    CloseHandle(handle);
+    return ok;
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || (uint64_t)info.st_size < bytes)
+        return false;
+    return ::truncate(path.c_str(), (off_t)bytes) == 0;
+#endif
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Byte-level snapshot of a run, for resuming after the process dies:
+//
+//   0  char[8]  magic "QPCHKPNT"    8  u32 version
+//  12  u32      byte-order mark    16  payload, as written by the put calls
+//  end u64      FNV-1a hash of everything before it
+//
+// The payload has no schema of its own; the reader must issue the same
+// sequence of get calls the writer issued puts. Each class that can be
+// checkpointed has a save/load pair that keeps the two in step. The same
+// stream, kept in memory, carries partial results between the processes of a
+// distributed run.
+
+class CheckpointWriter {
+public:
+    CheckpointWriter();
+
+    template <typename T> void put(T value) {
+        size_t offset = bytes.size();
+        bytes.resize(offset + sizeof(T));
+        std::memcpy(bytes.data() + offset, &value, sizeof(T));
+    }
+    void putString(const std::string &value);
+    void putDoubles(const std::vector<double> &values);
+
+    // Header, payload and hash, as commit() would write them.
+    std::vector<unsigned char> serialize() const;
+
+    // Writes to path + ".tmp", flushes it to disk and renames it over path,
+    // so a crash leaves either the previous checkpoint or this one.
+    bool commit(const std::string &path);
+
+    const std::string &error() const { return lastError; }
+
+private:
+    std::vector<unsigned char> bytes;
+    std::string lastError;
+};
+
+class CheckpointReader {
+public:
+    CheckpointReader();
+
+    bool open(const std::string &path);
+    // As open(), from bytes produced by CheckpointWriter::serialize. `name`
+    // only labels error messages.
+    bool parse(std::vector<unsigned char> data, const std::string &name);
+
+    // Reads past the end, or a getDoubles whose length does not match the
+    // destination, set the failed flag and leave the destination untouched.
+    template <typename T> T get() {
+        T value = T();
+        if (require(sizeof(T))) {
+            std::memcpy(&value, bytes.data() + offset, sizeof(T));
+            offset += sizeof(T);
+        }
+        return value;
+    }
+    std::string getString();
+    void getDoubles(std::vector<double> &values);
+
+    bool ok() const { return !failed; }
+    const std::string &error() const { return lastError; }
+
+private:
+    bool require(size_t count);
+
+    std::vector<unsigned char> bytes;
+    size_t offset;
+    size_t end;
+    bool failed;
+    std::string lastError;
+};
+
+// Cuts a file back to `bytes`, dropping output written after the checkpoint
+// that recorded that length. Fails if the file is shorter than that.
+bool truncateFile(const std::string &path, uint64_t bytes);
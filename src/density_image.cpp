@@ -0,0 +1,122 @@
+#include "density_image.h"
+
+#include <algorithm>
+#include <cmath>
+
+DensityImage::DensityImage(int width, int height, double xMin, double xMax)
+: columns(width), rows(height), xMin(xMin), xMax(xMax), paths(0),
+pixels((size_t)width * height * 3, 0.0f) {}
+
+void DensityImage::clear() {
+    std::fill(pixels.begin(), pixels.end(), 0.0f);
+    paths = 0;
+}
+
+void DensityImage::accumulate(const PathEnsemble &ensemble,
+                              const AmplitudePalette &palette,
+                              ThreadPool &pool) {
+    const int numPaths = ensemble.numPaths();
+    const int numSites = ensemble.numSites();
+    if (numPaths == 0 || numSites < 2)
+        return;
+
+    // Row centres in units of time slices, shared by every path.
+    rowSite.resize(rows);
+    rowFrac.resize(rows);
+    for (int y = 0; y < rows; y++) {
+        double s = (y + 0.5) / rows * (numSites - 1);
+        int k = std::min((int)s, numSites - 2);
+        rowSite[y] = k;
+        rowFrac[y] = (float)(s - k);
+    }
+
+    // Per-path splat colour, computed once instead of once per band.
+    splatColors.resize((size_t)numPaths * 3);
+    double magnitudeSum = 0.0;
+    for (int i = 0; i < numPaths; i++) {
+        double re = ensemble.amplitudesRe()[i];
+        double im = ensemble.amplitudesIm()[i];
+        const float *rgb = palette.hue(re, im);
+        float weight = (float)std::sqrt(re * re + im * im);
+        splatColors[3 * i] = rgb[0] * weight;
+        splatColors[3 * i + 1] = rgb[1] * weight;
+        splatColors[3 * i + 2] = rgb[2] * weight;
+        magnitudeSum += weight;
+    }
+    if (!(magnitudeSum > 0.0))
+        return;
+    const float normalize = (float)(numPaths / magnitudeSum);
+    for (size_t j = 0; j < splatColors.size(); j++) {
+        splatColors[j] *= normalize;
+    }
+
+    const float scale = (float)(columns / (xMax - xMin));
+    const float offset = (float)(-xMin * columns / (xMax - xMin) - 0.5);
+    const int bands = std::min(rows, pool.size());
+
+    pool.parallelFor(bands, [&](int b) {
+        const int y0 = (int)((int64_t)rows * b / bands);
+        const int y1 = (int)((int64_t)rows * (b + 1) / bands);
+        for (int i = 0; i < numPaths; i++) {
+            const double *path = ensemble.path(i);
+            const float *c = &splatColors[3 * (size_t)i];
+            for (int y = y0; y < y1; y++) {
+                const int k = rowSite[y];
+                const float f = rowFrac[y];
+                float x = (float)path[k] + f * (float)(path[k + 1] - path[k]);
+                float u = x * scale + offset;
+                if (!(u > -1.0f && u < (float)columns))
+                    continue;
+
+                // u > -1, so truncating u + 1 floors u.
+                int col = (int)(u + 1.0f) - 1;
+                float right = u - col;
+                float *row = &pixels[(size_t)y * columns * 3];
+                if (col >= 0) {
+                    float w = 1.0f - right;
+                    row[3 * col] += c[0] * w;
+                    row[3 * col + 1] += c[1] * w;
+                    row[3 * col + 2] += c[2] * w;
+                }
+                if (col + 1 < columns) {
+                    row[3 * col + 3] += c[0] * right;
+                    row[3 * col + 4] += c[1] * right;
+                    row[3 * col + 5] += c[2] * right;
+                }
+            }
+        }
+    });
+    paths += numPaths;
+}
+
+void DensityImage::toneMap(double exposure, ThreadPool &pool,
+                           PathColor *out) const {
+    double sum = 0.0;
+    size_t lit = 0;
+    for (size_t p = 0; p < pixels.size(); p += 3) {
+        double value = pixels[p] + pixels[p + 1] + pixels[p + 2];
+        if (value > 0.0) {
+            sum += value;
+            lit++;
+        }
+    }
+    // Averaged over phases, each channel holds a third of a pixel's total.
+    const float k = lit > 0 ? (float)(3.0 * exposure * lit / sum) : 0.0f;
+    const int bands = std::min(rows, pool.size());
+
+    pool.parallelFor(bands, [&](int b) {
+        const int y1 = (int)((int64_t)rows * (b + 1) / bands);
+        for (int y = (int)((int64_t)rows * b / bands); y < y1; y++) {
+            const float *row = &pixels[(size_t)y * columns * 3];
+            PathColor *line = out + (size_t)y * columns;
+            for (int col = 0; col < columns; col++) {
+                PathColor c;
+                c.r = (unsigned char)(255.0f * (1.0f - std::exp(-k * row[3 * col])) + 0.5f);
+                c.g = (unsigned char)(255.0f * (1.0f - std::exp(-k * row[3 * col + 1])) + 0.5f);
+                c.b = (unsigned char)(255.0f * (1.0f - std::exp(-k * row[3 * col + 2])) + 0.5f);
+                c.a = 255;
+                line[col] = c;
+            }
+        }
+    });
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "path_ensemble.h"
+#include "path_geometry.h"
+#include "thread_pool.h"
+
+// Ensembles rasterized into a (time x position) float image instead of being
+// drawn path by path. Row y is a time between the first and last slice,
+// column c an x bin in [xMin, xMax]; each path crosses every row once, at its
+// linear interpolation between time slices, and is splatted into the two
+// nearest columns with its palette hue times |A|. Each ensemble's |A| are
+// rescaled to average 1, so every path counts the same whatever the
+// ensemble's normalization (a real-time amplitude sum can be arbitrarily
+// close to zero). The cost per path is one pass over the rows whatever the
+// overdraw, and ensembles accumulate until clear(), so the image converges
+// over successive regenerations.
+class DensityImage {
+public:
+    DensityImage(int width, int height, double xMin, double xMax);
+
+    int width() const { return columns; }
+    int height() const { return rows; }
+    uint64_t pathCount() const { return paths; }
+
+    void clear();
+
+    // Splits the rows into one band per pool thread; every path crosses each
+    // row once, so the bands are equal work, each reads only the time slices
+    // it covers, and no two tasks touch the same pixel.
+    void accumulate(const PathEnsemble &ensemble,
+                    const AmplitudePalette &palette, ThreadPool &pool);
+
+    // RGBA8 (opaque) with channel = 1 - exp(-k value), k chosen so that the
+    // mean lit pixel lands at 1 - exp(-exposure).
+    void toneMap(double exposure, ThreadPool &pool, PathColor *out) const;
+
+private:
+    int columns, rows;
+    double xMin, xMax;
+    uint64_t paths;
+    // rows * columns * 3, row-major, r g b interleaved.
+    std::vector<float> pixels;
+    // Scratch for accumulate(): the time slice and fraction each row centre
+    // falls on, and every path's splat colour.
+    std::vector<int> rowSite;
+    std::vector<float> rowFrac;
+    std::vector<float> splatColors;
+};
@@ -0,0 +1,386 @@
+#include "ensemble_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char FILE_MAGIC[8] = {'Q', 'P', 'E', 'N', 'S', 'M', 'B', 'L'};
+static const char CHUNK_MAGIC[4] = {'C', 'H', 'N', 'K'};
+static const uint32_t FILE_VERSION = 4;
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+static const size_t FILE_HEADER_BYTES = 128;
+static const size_t CHUNK_HEADER_BYTES = 64;
+static const size_t PAYLOAD_ALIGN = 64;
+
+template <typename T> static void put(unsigned char *base, size_t offset, T value) {
+    std::memcpy(base + offset, &value, sizeof(T));
+}
+
+template <typename T> static T get(const unsigned char *base, size_t offset) {
+    T value;
+    std::memcpy(&value, base + offset, sizeof(T));
+    return value;
+}
+
+static uint64_t payloadBytes(uint64_t numPaths, int numSites, int precision) {
+    uint64_t bytes = numPaths * 3 * sizeof(double) +
+    numPaths * (uint64_t)numSites * precision;
+    return (bytes + PAYLOAD_ALIGN - 1) / PAYLOAD_ALIGN * PAYLOAD_ALIGN;
+}
+
+EnsembleFileWriter::EnsembleFileWriter()
+: file(nullptr), precision(POSITIONS_FLOAT64), totalPaths(0), numChunks(0) {}
+
+EnsembleFileWriter::~EnsembleFileWriter() { close(); }
+
+bool EnsembleFileWriter::fail(const std::string &message) {
+    lastError = message;
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+    return false;
+}
+
+bool EnsembleFileWriter::open(const std::string &path,
+                              const SimulationParams &params,
+                              PositionPrecision precision) {
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return fail("cannot open " + path + " for writing");
+
+    buffer.resize(1 << 20);
+    std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    this->params = params;
+    this->precision = precision;
+    totalPaths = 0;
+    numChunks = 0;
+    return writeHeader();
+}
+
+bool EnsembleFileWriter::writeHeader() {
+    unsigned char header[FILE_HEADER_BYTES];
+    std::memset(header, 0, sizeof(header));
+    std::memcpy(header, FILE_MAGIC, sizeof(FILE_MAGIC));
+    put<uint32_t>(header, 8, FILE_VERSION);
+    put<uint32_t>(header, 12, BYTE_ORDER_MARK);
+    put<uint32_t>(header, 16, (uint32_t)precision);
+    put<uint32_t>(header, 20, (uint32_t)params.timeSteps);
+    put<uint64_t>(header, 24, params.seed);
+    put<double>(header, 32, params.hbar);
+    put<double>(header, 40, params.mass);
+    put<double>(header, 48, params.dt);
+    put<double>(header, 56, params.x0);
+    put<double>(header, 64, params.xf);
+    put<double>(header, 72, params.sigma);
+    put<uint64_t>(header, 80, totalPaths);
+    put<uint64_t>(header, 88, numChunks);
+    put<uint32_t>(header, 96, (uint32_t)params.potential.kind);
+    put<uint32_t>(header, 100, params.euclidean ? 1u : 0u);
+    put<double>(header, 104, params.potential.a);
+    put<double>(header, 112, params.potential.b);
+    put<double>(header, 120, params.potential.c);
+
+    if (std::fwrite(header, 1, sizeof(header), file) != sizeof(header))
+        return fail("failed to write file header");
+    return true;
+}
+
+bool EnsembleFileWriter::write(const PathEnsemble &paths, uint64_t stream,
+                               uint64_t firstPath,
+                               const std::complex<double> &sum,
+                               double logWeightScale) {
+    if (!file)
+        return fail("file is not open");
+    if (paths.timeSteps() != params.timeSteps)
+        return fail("ensemble time steps do not match the file header");
+
+    const int numPaths = paths.numPaths();
+    const int numSites = paths.numSites();
+    const uint64_t payload = payloadBytes(numPaths, numSites, precision);
+
+    unsigned char header[CHUNK_HEADER_BYTES];
+    std::memset(header, 0, sizeof(header));
+    std::memcpy(header, CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+    put<uint32_t>(header, 4, (uint32_t)numPaths);
+    put<uint64_t>(header, 8, stream);
+    put<double>(header, 16, sum.real());
+    put<double>(header, 24, sum.imag());
+    put<uint64_t>(header, 32, payload);
+    put<uint64_t>(header, 40, firstPath);
+    put<double>(header, 48, logWeightScale);
+
+    bool ok = std::fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    ok = ok && std::fwrite(paths.actions(), sizeof(double), numPaths, file) ==
+    (size_t)numPaths;
+    ok = ok && std::fwrite(paths.amplitudesRe(), sizeof(double), numPaths,
+                           file) == (size_t)numPaths;
+    ok = ok && std::fwrite(paths.amplitudesIm(), sizeof(double), numPaths,
+                           file) == (size_t)numPaths;
+
+    rowStaging.resize(numSites);
+    for (int i = 0; ok && i < numPaths; i++) {
+        const double *path = paths.path(i);
+        if (precision == POSITIONS_FLOAT32) {
+            for (int t = 0; t < numSites; t++) {
+                rowStaging[t] = (float)path[t];
+            }
+            ok = std::fwrite(rowStaging.data(), sizeof(float), numSites, file) ==
+            (size_t)numSites;
+        } else {
+            ok = std::fwrite(path, sizeof(double), numSites, file) ==
+            (size_t)numSites;
+        }
+    }
+
+    uint64_t written =
+    (uint64_t)numPaths * (3 * sizeof(double) + (uint64_t)numSites * precision);
+    static const unsigned char zeros[PAYLOAD_ALIGN] = {0};
+    size_t padding = (size_t)(payload - written);
+    ok = ok && std::fwrite(zeros, 1, padding, file) == padding;
+
+    if (!ok)
+        return fail("failed to write chunk");
+
+    totalPaths += numPaths;
+    numChunks++;
+    return true;
+}
+
+bool EnsembleFileWriter::close() {
+    if (!file)
+        return true;
+
+    bool ok = std::fseek(file, 0, SEEK_SET) == 0 && writeHeader();
+    if (!file)
+        return false;
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    if (!ok)
+        lastError = "failed to finalize file";
+    return ok;
+}
+
+EnsembleFileReader::EnsembleFileReader()
+: data(nullptr), size(0),
+#if defined(_WIN32)
+fileHandle(nullptr), mappingHandle(nullptr),
+#endif
+positionPrecision(POSITIONS_FLOAT64), pathCount(0) {
+}
+
+EnsembleFileReader::~EnsembleFileReader() { close(); }
+
+bool EnsembleFileReader::fail(const std::string &message) {
+    lastError = message;
+    close();
+    return false;
+}
+
+void EnsembleFileReader::close() {
+#if defined(_WIN32)
+    if (data)
+        UnmapViewOfFile(data);
+    if (mappingHandle)
+        CloseHandle((HANDLE)mappingHandle);
+    if (fileHandle)
+        CloseHandle((HANDLE)fileHandle);
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+#else
+    if (data)
+        munmap((void *)data, size);
+#endif
+    data = nullptr;
+    size = 0;
+    chunks.clear();
+    pathCount = 0;
+}
+
+bool EnsembleFileReader::open(const std::string &path) {
+    close();
+
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return fail("cannot open " + path);
+    fileHandle = handle;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0)
+        return fail("cannot read the size of " + path);
+    size = (size_t)fileSize.QuadPart;
+
+    mappingHandle = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mappingHandle)
+        return fail("cannot map " + path);
+    data = (const unsigned char *)MapViewOfFile((HANDLE)mappingHandle,
+                                                FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+        return fail("cannot map " + path);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return fail("cannot open " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return fail("cannot read the size of " + path);
+    }
+    size = (size_t)info.st_size;
+
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        size = 0;
+        return fail("cannot map " + path);
+    }
+    data = (const unsigned char *)mapping;
+#endif
+
+    if (size < FILE_HEADER_BYTES || std::memcmp(data, FILE_MAGIC, 8) != 0)
+        return fail(path + " is not an ensemble file");
+    if (get<uint32_t>(data, 12) != BYTE_ORDER_MARK)
+        return fail(path + " was written with a different byte order");
+    uint32_t version = get<uint32_t>(data, 8);
+    if (version < 1 || version > FILE_VERSION)
+        return fail(path + " has an unsupported version");
+
+    uint32_t bytesPerPosition = get<uint32_t>(data, 16);
+    if (bytesPerPosition != POSITIONS_FLOAT32 &&
+        bytesPerPosition != POSITIONS_FLOAT64)
+        return fail(path + " has an invalid position precision");
+    positionPrecision = (PositionPrecision)bytesPerPosition;
+
+    fileParams.timeSteps = (int)get<uint32_t>(data, 20);
+    fileParams.seed = get<uint64_t>(data, 24);
+    fileParams.hbar = get<double>(data, 32);
+    fileParams.mass = get<double>(data, 40);
+    fileParams.dt = get<double>(data, 48);
+    fileParams.x0 = get<double>(data, 56);
+    fileParams.xf = get<double>(data, 64);
+    fileParams.sigma = get<double>(data, 72);
+    if (fileParams.timeSteps <= 0)
+        return fail(path + " has an invalid number of time steps");
+
+    // Version 1 files predate selectable potentials and are harmonic.
+    fileParams.potential = Potential();
+    fileParams.euclidean = false;
+    if (version >= 2) {
+        uint32_t kind = get<uint32_t>(data, 96);
+        if (kind > POTENTIAL_TABULATED)
+            return fail(path + " has an unknown potential");
+        fileParams.potential.kind = (PotentialKind)kind;
+        fileParams.potential.a = get<double>(data, 104);
+        fileParams.potential.b = get<double>(data, 112);
+        fileParams.potential.c = get<double>(data, 120);
+        fileParams.euclidean = (get<uint32_t>(data, 100) & 1) != 0;
+    }
+
+    // Walk the chunks rather than trusting the header totals, so a file whose
+    // writer died before close() is still readable up to its last full chunk.
+    size_t offset = FILE_HEADER_BYTES;
+    while (offset + CHUNK_HEADER_BYTES <= size) {
+        const unsigned char *header = data + offset;
+        if (std::memcmp(header, CHUNK_MAGIC, 4) != 0)
+            break;
+
+        EnsembleChunk chunk;
+        chunk.numPaths = (int)get<uint32_t>(header, 4);
+        chunk.stream = get<uint64_t>(header, 8);
+        chunk.firstPath = version >= 3 ? get<uint64_t>(header, 40) : 0;
+        chunk.amplitudeSum = std::complex<double>(get<double>(header, 16),
+                                                  get<double>(header, 24));
+        chunk.logWeightScale = version >= 4 ? get<double>(header, 48) : 0.0;
+        chunk.ensembleScale = 1.0;
+        uint64_t payload = get<uint64_t>(header, 32);
+        if (payload != payloadBytes(chunk.numPaths, numSites(), bytesPerPosition) ||
+            offset + CHUNK_HEADER_BYTES + payload > size)
+            break;
+
+        const unsigned char *body = header + CHUNK_HEADER_BYTES;
+        chunk.actions = (const double *)body;
+        chunk.amplitudesRe = chunk.actions + chunk.numPaths;
+        chunk.amplitudesIm = chunk.amplitudesRe + chunk.numPaths;
+        const void *positions = chunk.amplitudesIm + chunk.numPaths;
+        chunk.positions32 = positionPrecision == POSITIONS_FLOAT32
+                            ? (const float *)positions
+                            : nullptr;
+        chunk.positions64 = positionPrecision == POSITIONS_FLOAT64
+                            ? (const double *)positions
+                            : nullptr;
+
+        chunks.push_back(chunk);
+        pathCount += chunk.numPaths;
+        offset += CHUNK_HEADER_BYTES + (size_t)payload;
+    }
+
+    if (chunks.empty())
+        return fail(path + " contains no complete chunks");
+
+    // Undo each batch's normalization: its weights go back on the largest
+    // log-scale of its ensemble and are divided by the ensemble's total. The
+    // generator leaves amplitudes whose sum is negligible unnormalized.
+    std::map<uint64_t, double> largest;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        std::map<uint64_t, double>::iterator it = largest.find(chunks[i].stream);
+        if (it == largest.end())
+            largest[chunks[i].stream] = chunks[i].logWeightScale;
+        else
+            it->second = std::max(it->second, chunks[i].logWeightScale);
+    }
+    std::map<uint64_t, std::complex<double> > totals;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const EnsembleChunk &c = chunks[i];
+        totals[c.stream] += c.amplitudeSum *
+                            std::exp(c.logWeightScale - largest[c.stream]);
+    }
+    for (size_t i = 0; i < chunks.size(); i++) {
+        EnsembleChunk &c = chunks[i];
+        const std::complex<double> total = totals[c.stream];
+        std::complex<double> scale =
+        (std::abs(c.amplitudeSum) > 1e-10 ? c.amplitudeSum : 1.0) *
+        std::exp(c.logWeightScale - largest[c.stream]);
+        c.ensembleScale = std::abs(total) > 1e-10 ? scale / total : scale;
+    }
+    fileParams.numPaths = chunks[0].numPaths;
+    return true;
+}
+
+void EnsembleFileReader::load(int i, PathEnsemble &paths) const {
+    const EnsembleChunk &c = chunks[i];
+    const int sites = numSites();
+    paths.resize(c.numPaths, fileParams.timeSteps);
+
+    for (int p = 0; p < c.numPaths; p++) {
+        double *row = paths.path(p);
+        if (c.positions32) {
+            const float *src = c.positions32 + (size_t)p * sites;
+            for (int t = 0; t < sites; t++) {
+                row[t] = src[t];
+            }
+        } else {
+            std::memcpy(row, c.positions64 + (size_t)p * sites,
+                        sites * sizeof(double));
+        }
+    }
+    std::memcpy(paths.actions(), c.actions, c.numPaths * sizeof(double));
+    std::memcpy(paths.amplitudesRe(), c.amplitudesRe, c.numPaths * sizeof(double));
+    std::memcpy(paths.amplitudesIm(), c.amplitudesIm, c.numPaths * sizeof(double));
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "path_ensemble.h"
+#include "simulation_params.h"
+
+// Chunked binary archive of sampled ensembles (little-endian):
+//
+//   file header, 128 bytes
+//     0  char[8]  magic "QPENSMBL"      8  u32 version
+//    12  u32      byte-order mark      16  u32 bytes per position (4 or 8)
+//    20  u32      time steps           24  u64 seed
+//    32  f64      hbar, mass, dt, x0, xf, sigma
+//    80  u64      total paths          88  u64 chunk count
+//    96  u32      potential kind      100  u32 flags (bit 0: Euclidean weights)
+//   104  f64      potential a, b, c
+//                 (tabulated samples are not archived)
+//   chunk header, 64 bytes
+//     0  char[4]  "CHNK"                4  u32 paths in chunk
+//     8  u64      stream (regeneration index)
+//    16  f64      amplitude sum re, im 32  u64 payload bytes
+//    40  u64      first path (index of the chunk's first path in its
+//                 ensemble; version 3, 0 before)
+//    48  f64      log weight scale (Euclidean weights before normalizing
+//                 were relative to exp of this; version 4, 0 before)
+//   chunk payload, padded to 64 bytes
+//     f64 actions[n], f64 amplitudeRe[n], f64 amplitudeIm[n],
+//     positions[n][timeSteps + 1] as float32 or float64
+//
+// Writers stream chunks with plain sequential writes and patch the totals on
+// close; readers map the file and hand out pointers into the mapping.
+
+enum PositionPrecision { POSITIONS_FLOAT32 = 4, POSITIONS_FLOAT64 = 8 };
+
+class EnsembleFileWriter {
+public:
+    EnsembleFileWriter();
+    ~EnsembleFileWriter();
+
+    EnsembleFileWriter(const EnsembleFileWriter &) = delete;
+    EnsembleFileWriter &operator=(const EnsembleFileWriter &) = delete;
+
+    bool open(const std::string &path, const SimulationParams &params,
+              PositionPrecision precision);
+
+    // Appends one ensemble, or one batch of it starting at firstPath, as a
+    // chunk. sum is the amplitude sum returned by PathGenerator::generate
+    // (the stored amplitudes are normalized by it), and logWeightScale the
+    // generator's logWeightScale() for Euclidean weights.
+    bool write(const PathEnsemble &paths, uint64_t stream, uint64_t firstPath,
+               const std::complex<double> &sum, double logWeightScale = 0.0);
+
+    bool close();
+
+    bool isOpen() const { return file != nullptr; }
+    const std::string &error() const { return lastError; }
+
+private:
+    bool fail(const std::string &message);
+    bool writeHeader();
+
+    std::FILE *file;
+    std::vector<char> buffer;
+    std::vector<float> rowStaging;
+    SimulationParams params;
+    PositionPrecision precision;
+    uint64_t totalPaths;
+    uint64_t numChunks;
+    std::string lastError;
+};
+
+struct EnsembleChunk {
+    int numPaths;
+    uint64_t stream;
+    // With --batch an ensemble spans several chunks; path p of this chunk is
+    // path firstPath + p of the ensemble.
+    uint64_t firstPath;
+    std::complex<double> amplitudeSum;
+    double logWeightScale;
+    // Each batch was normalized on its own. Multiplying this chunk's
+    // amplitudes by ensembleScale normalizes them over every chunk of the
+    // same stream instead, as one unbatched run would have; 1 for an
+    // ensemble written as a single chunk.
+    std::complex<double> ensembleScale;
+    const double *actions;
+    const double *amplitudesRe;
+    const double *amplitudesIm;
+    // Exactly one of these is set, depending on the file's precision.
+    const float *positions32;
+    const double *positions64;
+};
+
+class EnsembleFileReader {
+public:
+    EnsembleFileReader();
+    ~EnsembleFileReader();
+
+    EnsembleFileReader(const EnsembleFileReader &) = delete;
+    EnsembleFileReader &operator=(const EnsembleFileReader &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    const SimulationParams &params() const { return fileParams; }
+    PositionPrecision precision() const { return positionPrecision; }
+    int numSites() const { return fileParams.timeSteps + 1; }
+    uint64_t totalPaths() const { return pathCount; }
+    int numChunks() const { return (int)chunks.size(); }
+
+    const EnsembleChunk &chunk(int i) const { return chunks[i]; }
+
+    // Copies a chunk into an ensemble, e.g. for replay in the viewer.
+    void load(int i, PathEnsemble &paths) const;
+
+    const std::string &error() const { return lastError; }
+
+private:
+    bool fail(const std::string &message);
+
+    const unsigned char *data;
+    size_t size;
+#if defined(_WIN32)
+    void *fileHandle;
+    void *mappingHandle;
+#endif
+
+    SimulationParams fileParams;
+    PositionPrecision positionPrecision;
+    uint64_t pathCount;
+    std::vector<EnsembleChunk> chunks;
+    std::string lastError;
+};
@@ -1,90 +1,416 @@
+#if !defined(_WIN32)
+#define GL_GLEXT_PROTOTYPES
+#endif
 #include <GL/glut.h>
+#include <algorithm>
 #include <cmath>
 #include <complex>
+#include <cstddef>
 #include <iostream>
 #include <random>
+#include <string>
 #include <vector>
 
+#include "background_generator.h"
+#include "density_image.h"
+#include "ensemble_file.h"
+#include "path_ensemble.h"
+#include "path_geometry.h"
+#include "path_state.h"
+#include "profiler.h"
+
 const int LATTICE_SIZE = 100;
 const int TIME_STEPS = 50;
 const int NUM_PATHS = 1000;
+// Density mode: paths per regeneration and the accumulation image size.
+const int DENSITY_PATHS = 20000;
+const int DENSITY_WIDTH = 512;
+const int DENSITY_HEIGHT = 256;
 const double HBAR = 1.0;
 const double MASS = 1.0;
 const double DT = 0.1;
 const double DX = 0.1;
+const char *const TRACE_FILE = "path_integral_trace.json";
+
+#if defined(_WIN32)
+// opengl32.dll only exports GL 1.1; fetch the buffer object entry points.
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_STATIC_DRAW 0x88E4
+#define GL_DYNAMIC_DRAW 0x88E8
+#endif
+
+typedef void(APIENTRY *GenBuffersFn)(GLsizei, GLuint *);
+typedef void(APIENTRY *BindBufferFn)(GLenum, GLuint);
+typedef void(APIENTRY *BufferDataFn)(GLenum, ptrdiff_t, const void *, GLenum);
+typedef void(APIENTRY *BufferSubDataFn)(GLenum, ptrdiff_t, ptrdiff_t,
+                                        const void *);
+typedef void(APIENTRY *MultiDrawArraysFn)(GLenum, const GLint *,
+                                          const GLsizei *, GLsizei);
+
+static GenBuffersFn glGenBuffers = nullptr;
+static BindBufferFn glBindBuffer = nullptr;
+static BufferDataFn glBufferData = nullptr;
+static BufferSubDataFn glBufferSubData = nullptr;
+static MultiDrawArraysFn glMultiDrawArrays = nullptr;
+
+static bool loadBufferFunctions() {
+    glGenBuffers = (GenBuffersFn)wglGetProcAddress("glGenBuffers");
+    glBindBuffer = (BindBufferFn)wglGetProcAddress("glBindBuffer");
+    glBufferData = (BufferDataFn)wglGetProcAddress("glBufferData");
+    glBufferSubData = (BufferSubDataFn)wglGetProcAddress("glBufferSubData");
+    glMultiDrawArrays =
+    (MultiDrawArraysFn)wglGetProcAddress("glMultiDrawArrays");
+    return glGenBuffers && glBindBuffer && glBufferData && glBufferSubData &&
+    glMultiDrawArrays;
+}
+#else
+static bool loadBufferFunctions() { return true; }
+#endif
+
+typedef PathVertex ColoredVertex;
+
+// Retained-mode geometry: the grid, axes, endpoints and potential curve live
+// in one static buffer; the ensemble is rebuilt into a second buffer only
+// when the paths change and drawn with one multi-draw plus one point draw.
+// In density mode a tone-mapped DensityImage replaces the paths as a single
+// textured quad.
+class PathRenderer {
+private:
+    GLuint staticBuffer;
+    GLuint pathBuffer;
+    GLuint densityTexture;
+    GLint axesFirst, gridFirst, endpointsFirst, potentialFirst;
+    GLsizei axesCount, gridCount, endpointsCount, potentialCount;
+
+    AmplitudePalette palette;
+    std::vector<PathColor> colors;
+    std::vector<ColoredVertex> vertices;
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+    size_t pathBufferSize;
+    std::vector<PathColor> densityPixels;
+
+    static ColoredVertex vertex(float x, float y, float r, float g, float b,
+                                float a) {
+        ColoredVertex v;
+        v.x = x;
+        v.y = y;
+        v.r = (GLubyte)(r * 255.0f + 0.5f);
+        v.g = (GLubyte)(g * 255.0f + 0.5f);
+        v.b = (GLubyte)(b * 255.0f + 0.5f);
+        v.a = (GLubyte)(a * 255.0f + 0.5f);
+        return v;
+    }
 
-struct Path {
-    std::vector<double> positions;
-    std::complex<double> amplitude;
-    double action;
-};
+    static void bindVertexArrays(GLuint buffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glVertexPointer(2, GL_FLOAT, sizeof(ColoredVertex),
+                        (const void *)offsetof(ColoredVertex, x));
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ColoredVertex),
+                       (const void *)offsetof(ColoredVertex, r));
+    }
 
-class PathIntegralSimulation {
-private:
-    std::vector<Path> paths;
-    std::mt19937 rng;
-    std::normal_distribution<double> gaussian;
-    int currentFrame;
-    double totalTime;
+public:
+    PathRenderer()
+    : staticBuffer(0), pathBuffer(0), densityTexture(0), pathBufferSize(0) {}
+
+    const AmplitudePalette &getPalette() const { return palette; }
+
+    bool init(const Potential &V) {
+        if (!loadBufferFunctions())
+            return false;
+
+        glGenBuffers(1, &staticBuffer);
+        glGenBuffers(1, &pathBuffer);
+
+        glGenTextures(1, &densityTexture);
+        glBindTexture(GL_TEXTURE_2D, densityTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        std::vector<ColoredVertex> geometry;
 
-    double V(double x) {
-        return 0.5 * x * x;
+        axesFirst = (GLint)geometry.size();
+        geometry.push_back(vertex(-5, 0, 0.3f, 0.3f, 0.3f, 1.0f));
+        geometry.push_back(vertex(5, 0, 0.3f, 0.3f, 0.3f, 1.0f));
+        geometry.push_back(vertex(0, -3, 0.3f, 0.3f, 0.3f, 1.0f));
+        geometry.push_back(vertex(0, 3, 0.3f, 0.3f, 0.3f, 1.0f));
+        axesCount = (GLsizei)geometry.size() - axesFirst;
+
+        gridFirst = (GLint)geometry.size();
+        for (int i = -50; i <= 50; i++) {
+            if (i % 10 == 0)
+                continue;
+            geometry.push_back(vertex(i * 0.1f, -3, 0.1f, 0.1f, 0.1f, 1.0f));
+            geometry.push_back(vertex(i * 0.1f, 3, 0.1f, 0.1f, 0.1f, 1.0f));
+        }
+        for (int i = -30; i <= 30; i++) {
+            if (i % 10 == 0)
+                continue;
+            geometry.push_back(vertex(-5, i * 0.1f, 0.1f, 0.1f, 0.1f, 1.0f));
+            geometry.push_back(vertex(5, i * 0.1f, 0.1f, 0.1f, 0.1f, 1.0f));
+        }
+        gridCount = (GLsizei)geometry.size() - gridFirst;
+
+        endpointsFirst = (GLint)geometry.size();
+        geometry.push_back(vertex(-2.0f, -2.5f, 1.0f, 0.0f, 0.0f, 1.0f));
+        geometry.push_back(vertex(2.0f, 2.5f, 1.0f, 0.0f, 0.0f, 1.0f));
+        endpointsCount = (GLsizei)geometry.size() - endpointsFirst;
+
+        potentialFirst = (GLint)geometry.size();
+        for (int i = -50; i <= 50; i++) {
+            double x = i * 0.1;
+            float py = (float)(-2.8 + V.value(x) * 0.1);
+            geometry.push_back(vertex((float)x, py, 0.5f, 0.5f, 1.0f, 1.0f));
+        }
+        potentialCount = (GLsizei)geometry.size() - potentialFirst;
+
+        glBindBuffer(GL_ARRAY_BUFFER, staticBuffer);
+        glBufferData(GL_ARRAY_BUFFER, geometry.size() * sizeof(ColoredVertex),
+                     geometry.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return true;
     }
 
-    double calculateAction(const std::vector<double> &positions) {
-        double action = 0.0;
-        for (int t = 1; t < positions.size(); t++) {
-            double dx = positions[t] - positions[t - 1];
-            double kinetic = 0.5 * MASS * dx * dx / (DT * DT);
-            double potential = V(positions[t]);
-            action += (kinetic - potential) * DT;
+    void uploadPaths(const PathEnsemble &paths, ThreadPool &pool) {
+        const int numPaths = paths.numPaths();
+        const int numSites = paths.numSites();
+        colors.resize(numPaths);
+        vertices.resize((size_t)numPaths * numSites);
+        firsts.resize(numPaths);
+        counts.resize(numPaths);
+
+        {
+            ScopedTimer timer("colors");
+            palette.colorEnsemble(paths, pool, colors.data());
+        }
+        {
+            ScopedTimer timer("geometry");
+            buildEnsembleVertices(paths, colors.data(), pool, vertices.data());
+            for (int i = 0; i < numPaths; i++) {
+                firsts[i] = i * numSites;
+                counts[i] = numSites;
+            }
+        }
+
+        ScopedTimer timer("upload");
+        size_t bytes = vertices.size() * sizeof(ColoredVertex);
+        glBindBuffer(GL_ARRAY_BUFFER, pathBuffer);
+        if (bytes > pathBufferSize) {
+            glBufferData(GL_ARRAY_BUFFER, bytes, vertices.data(), GL_DYNAMIC_DRAW);
+            pathBufferSize = bytes;
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, vertices.data());
         }
-        return action;
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void uploadPath(const PathEnsemble &paths, int i) {
+        ScopedTimer timer("geometry");
+        const int numSites = paths.numSites();
+        ColoredVertex *row = &vertices[(size_t)i * numSites];
+        colors[i] = palette.color(paths.amplitudesRe()[i], paths.amplitudesIm()[i]);
+        buildPathVertices(paths, i, colors[i], row);
+
+        glBindBuffer(GL_ARRAY_BUFFER, pathBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        (size_t)i * numSites * sizeof(ColoredVertex),
+                        numSites * sizeof(ColoredVertex), row);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void uploadDensity(const DensityImage &density, ThreadPool &pool) {
+        ScopedTimer timer("tone map");
+        densityPixels.resize((size_t)density.width() * density.height());
+        density.toneMap(1.0, pool, densityPixels.data());
+
+        glBindTexture(GL_TEXTURE_2D, densityTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, density.width(),
+                     density.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     densityPixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void drawBackground() {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        bindVertexArrays(staticBuffer);
+        glDrawArrays(GL_LINES, axesFirst, axesCount);
+        glDrawArrays(GL_LINES, gridFirst, gridCount);
+    }
+
+    void drawPaths() {
+        if (firsts.empty())
+            return;
+
+        bindVertexArrays(pathBuffer);
+        glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(),
+                          (GLsizei)firsts.size());
+        glPointSize(2.0f);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)vertices.size());
     }
 
-    std::vector<double> generateRandomPath(double x0, double xf) {
-        std::vector<double> path(TIME_STEPS + 1);
-        path[0] = x0;
-        path[TIME_STEPS] = xf;
+    // Added on top of the grid: black texels leave it visible.
+    void drawDensity() {
+        static const GLfloat corners[] = {-5, -2.5f, 5, -2.5f, 5, 2.5f, -5, 2.5f};
+        static const GLfloat texCoords[] = {0, 0, 1, 0, 1, 1, 0, 1};
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, corners);
+        glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+
+        glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, densityTexture);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glDrawArrays(GL_QUADS, 0, 4);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDisable(GL_TEXTURE_2D);
+
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+    }
+
+    void drawForeground() {
+        bindVertexArrays(staticBuffer);
+        glPointSize(8.0f);
+        glDrawArrays(GL_POINTS, endpointsFirst, endpointsCount);
+        glDrawArrays(GL_LINE_STRIP, potentialFirst, potentialCount);
+
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
 
-        for (int t = 1; t < TIME_STEPS; t++) {
-            double alpha = (double)t / TIME_STEPS;
-            path[t] = (1 - alpha) * x0 + alpha * xf;
-            path[t] += gaussian(rng) * 0.5;
+class PathIntegralSimulation {
+private:
+    PathEnsemble paths;
+    BackgroundGenerator generator;
+    ThreadPool geometryPool;
+    PathRenderer renderer;
+    DensityImage density;
+    bool geometryDirty;
+    bool densityPending;
+    int dirtyPath;
+    uint64_t generation;
+    std::complex<double> amplitudeSum;
+    std::complex<double> normalization;
+    PathState dragState;
+    int dragPath;
+    int dragSite;
+    int windowWidth, windowHeight;
+    int currentFrame;
+    double totalTime;
+    EnsembleFileReader replay;
+    int replayChunk;
+    int densityEnsembles;
+    bool showProfiler;
+    bool euclidean;
+    bool densityMode;
+
+    Potential potential;
+
+    SimulationParams params() const {
+        if (replay.numChunks() > 0) {
+            SimulationParams p = replay.params();
+            p.potential = potential;
+            p.euclidean = euclidean;
+            return p;
         }
 
-        return path;
+        SimulationParams p;
+        p.numPaths = densityMode ? DENSITY_PATHS : NUM_PATHS;
+        p.timeSteps = TIME_STEPS;
+        p.hbar = HBAR;
+        p.mass = MASS;
+        p.dt = DT;
+        p.x0 = -2.0;
+        p.xf = 2.0;
+        p.seed = 42;
+        p.potential = potential;
+        p.euclidean = euclidean;
+        return p;
     }
 
 public:
     PathIntegralSimulation()
-    : rng(42), gaussian(0.0, 1.0), currentFrame(0), totalTime(0.0) {
+    : density(DENSITY_WIDTH, DENSITY_HEIGHT, -5.0, 5.0), geometryDirty(true),
+    densityPending(false), dirtyPath(-1), generation(0), dragPath(-1),
+    dragSite(-1), windowWidth(1200), windowHeight(800), currentFrame(0),
+    totalTime(0.0), replayChunk(0), densityEnsembles(0), showProfiler(false),
+    euclidean(false),
+    densityMode(false) {
         generatePaths();
+        generator.wait();
+        collectPaths();
     }
 
-    void generatePaths() {
-        paths.clear();
-        double x0 = -2.0;
-        double xf = 2.0;
+    bool init() { return renderer.init(potential); }
 
-        for (int i = 0; i < NUM_PATHS; i++) {
-            Path path;
-            path.positions = generateRandomPath(x0, xf);
-            path.action = calculateAction(path.positions);
+    const Potential &getPotential() const { return potential; }
 
-            std::complex<double> phase(0, -path.action / HBAR);
-            path.amplitude = std::exp(phase);
+    // Call before init(); the curve is baked into the static geometry.
+    void setPotential(const Potential &V) {
+        potential = V;
+        generatePaths();
+    }
 
-            paths.push_back(path);
+    // Replays a stored ensemble file chunk by chunk instead of sampling.
+    bool openReplay(const std::string &path) {
+        if (!replay.open(path)) {
+            std::cout << "Cannot replay " << path << ": " << replay.error()
+            << std::endl;
+            return false;
         }
+        replayChunk = 0;
+        potential = replay.params().potential;
+        euclidean = replay.params().euclidean;
+        generatePaths();
+        return true;
+    }
 
-        std::complex<double> sum(0, 0);
-        for (const auto &path : paths) {
-            sum += path.amplitude;
+    // Sampling runs in the background; the new ensemble is swapped in by
+    // collectPaths() once it is ready. Replay chunks load synchronously.
+    void generatePaths() {
+        if (replay.numChunks() > 0) {
+            replay.load(replayChunk, paths);
+            amplitudeSum = replay.chunk(replayChunk).amplitudeSum;
+            replayChunk = (replayChunk + 1) % replay.numChunks();
+            ensembleChanged();
+        } else {
+            generator.request(params(), generation++);
         }
+    }
+
+    // A drag in progress keeps its ensemble; a finished one waits until the
+    // drag is released.
+    void collectPaths() {
+        if (replay.numChunks() > 0 || dragPath >= 0)
+            return;
+        if (generator.collect(paths, amplitudeSum))
+            ensembleChanged();
+    }
 
-        for (auto &path : paths) {
-            path.amplitude /= sum;
+    // In density mode every ensemble is folded in as it arrives, so none is
+    // lost when several arrive between two frames; render() only uploads.
+    void ensembleChanged() {
+        dragPath = -1;
+        geometryDirty = true;
+        normalization = std::abs(amplitudeSum) > 1e-10 ? amplitudeSum : 1.0;
+        if (densityMode) {
+            ScopedTimer timer("density");
+            density.accumulate(paths, renderer.getPalette(), geometryPool);
+            densityEnsembles++;
+            densityPending = true;
         }
     }
 
@@ -92,12 +418,36 @@ public:
         currentFrame++;
         totalTime += 0.016;
 
-        if (currentFrame % 120 == 0) {
+        // Density mode keeps the generator busy; a replay is folded in once,
+        // chunk by chunk, and then the image stays as it is.
+        bool next = currentFrame % 120 == 0;
+        if (densityMode && replay.numChunks() > 0)
+            next = densityEnsembles < replay.numChunks();
+        else if (densityMode)
+            next = !generator.busy();
+        if (next)
             generatePaths();
-        }
+        collectPaths();
+    }
+
+    // Starts a fresh density image, from the first chunk when replaying. An
+    // ensemble still being generated for the old settings is collected first
+    // so it does not land in the new image.
+    void restartDensity() {
+        generator.wait();
+        collectPaths();
+        density.clear();
+        densityEnsembles = 0;
+        densityPending = true;
+        replayChunk = 0;
+        generatePaths();
     }
 
     void render() {
+        Profiler &profiler = Profiler::instance();
+        profiler.endFrame();
+        profiler.beginFrame();
+
         glClear(GL_COLOR_BUFFER_BIT);
 
         glMatrixMode(GL_PROJECTION);
@@ -107,117 +457,211 @@ public:
         glMatrixMode(GL_MODELVIEW);
         glLoadIdentity();
 
-        glColor3f(0.3f, 0.3f, 0.3f);
-        glBegin(GL_LINES);
-        glVertex2f(-5, 0);
-        glVertex2f(5, 0);
-        glVertex2f(0, -3);
-        glVertex2f(0, 3);
-        glEnd();
-
-        glColor3f(0.1f, 0.1f, 0.1f);
-        glBegin(GL_LINES);
-        for (int i = -50; i <= 50; i++) {
-            if (i % 10 == 0)
-                continue;
-            glVertex2f(i * 0.1f, -3);
-            glVertex2f(i * 0.1f, 3);
-        }
-        for (int i = -30; i <= 30; i++) {
-            if (i % 10 == 0)
-                continue;
-            glVertex2f(-5, i * 0.1f);
-            glVertex2f(5, i * 0.1f);
-        }
-        glEnd();
-
-        for (size_t i = 0; i < paths.size(); i++) {
-            const Path &path = paths[i];
-
-            double magnitude = std::abs(path.amplitude);
-            double phase = std::arg(path.amplitude);
-
-            float r = (float)(0.5 + 0.5 * cos(phase));
-            float g = (float)(0.5 + 0.5 * cos(phase + 2 * M_PI / 3));
-            float b = (float)(0.5 + 0.5 * cos(phase + 4 * M_PI / 3));
-
-            float alpha = (float)(magnitude * 10);
-            if (alpha > 1.0f)
-                alpha = 1.0f;
-
-            glColor4f(r * alpha, g * alpha, b * alpha, alpha);
-
-            glBegin(GL_LINE_STRIP);
-            for (int t = 0; t < path.positions.size(); t++) {
-                float x = (float)path.positions[t];
-                float y = (float)(-2.5 + 5.0 * t / (path.positions.size() - 1));
-                glVertex2f(x, y);
-            }
-            glEnd();
-
-            glPointSize(2.0f);
-            glBegin(GL_POINTS);
-            for (int t = 0; t < path.positions.size(); t++) {
-                float x = (float)path.positions[t];
-                float y = (float)(-2.5 + 5.0 * t / (path.positions.size() - 1));
-                glVertex2f(x, y);
+        if (densityMode) {
+            if (densityPending) {
+                renderer.uploadDensity(density, geometryPool);
+                densityPending = false;
             }
-            glEnd();
+        } else if (geometryDirty) {
+            renderer.uploadPaths(paths, geometryPool);
+            geometryDirty = false;
+            dirtyPath = -1;
+        } else if (dirtyPath >= 0) {
+            renderer.uploadPath(paths, dirtyPath);
+            dirtyPath = -1;
         }
 
-        glPointSize(8.0f);
-        glColor3f(1.0f, 0.0f, 0.0f);
-        glBegin(GL_POINTS);
-        glVertex2f(-2.0f, -2.5f);
-        glVertex2f(2.0f, 2.5f);
-        glEnd();
-
-        glColor3f(0.5f, 0.5f, 1.0f);
-        glBegin(GL_LINE_STRIP);
-        for (int i = -50; i <= 50; i++) {
-            double x = i * 0.1;
-            double potential = V(x);
-            float px = (float)x;
-            float py = (float)(-2.8 + potential * 0.1);
-            glVertex2f(px, py);
+        {
+            ScopedTimer timer("draw");
+            renderer.drawBackground();
+            if (densityMode)
+                renderer.drawDensity();
+            else
+                renderer.drawPaths();
+            renderer.drawForeground();
         }
-        glEnd();
 
         glColor3f(1.0f, 1.0f, 1.0f);
         glRasterPos2f(-4.8f, 2.7f);
         std::string info =
-        "1D Quantum Path Integral - Paths: " + std::to_string(NUM_PATHS);
+        "1D Quantum Path Integral - Paths: " +
+        (densityMode ? std::to_string(density.pathCount()) + " accumulated"
+                     : std::to_string(paths.numPaths()));
         for (char c : info) {
             glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, c);
         }
 
         glRasterPos2f(-4.8f, 2.5f);
-        std::string timeInfo = "Time Steps: " + std::to_string(TIME_STEPS);
+        std::string timeInfo = "Time Steps: " + std::to_string(paths.timeSteps());
         for (char c : timeInfo) {
             glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, c);
         }
 
         glRasterPos2f(-4.8f, -2.9f);
-        std::string legend =
-        "Red: Start/End | Blue: Harmonic Potential | Colors: Path Amplitudes";
+        std::string legend = std::string("Red: Start/End | Blue: ") +
+        potential.name() + " potential | Colors: " +
+        (euclidean ? "Euclidean Weights" : "Path Amplitudes");
         for (char c : legend) {
             glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, c);
         }
 
+        if (showProfiler)
+            drawProfilerOverlay();
+
         glutSwapBuffers();
     }
 
+    void drawProfilerOverlay() {
+        std::string text = Profiler::instance().summary(paths.numPaths());
+        float y = 2.7f;
+        size_t begin = 0;
+        while (begin < text.size()) {
+            size_t end = text.find('\n', begin);
+            if (end == std::string::npos)
+                end = text.size();
+            glRasterPos2f(1.2f, y);
+            for (size_t i = begin; i < end; i++) {
+                glutBitmapCharacter(GLUT_BITMAP_8_BY_13, text[i]);
+            }
+            y -= 0.12f;
+            begin = end + 1;
+        }
+    }
+
+    void toggleTrace() {
+        Profiler &profiler = Profiler::instance();
+        if (!profiler.isTracing()) {
+            profiler.startTrace();
+            std::cout << "Recording trace..." << std::endl;
+            return;
+        }
+        profiler.stopTrace();
+        if (profiler.writeTrace(TRACE_FILE))
+            std::cout << "Trace written to " << TRACE_FILE << std::endl;
+        else
+            std::cout << "Cannot write " << TRACE_FILE << std::endl;
+    }
+
     void keyPressed(unsigned char key, int x, int y) {
         switch (key) {
             case 'r':
             case 'R':
-                generatePaths();
+                if (densityMode)
+                    restartDensity();
+                else
+                    generatePaths();
+                break;
+            case 'd':
+            case 'D':
+                densityMode = !densityMode;
+                restartDensity();
+                break;
+            case 'p':
+            case 'P':
+                showProfiler = !showProfiler;
+                Profiler::instance().setEnabled(showProfiler);
+                break;
+            case 't':
+            case 'T':
+                toggleTrace();
+                break;
+            case 'e':
+            case 'E':
+                if (replay.numChunks() == 0) {
+                    euclidean = !euclidean;
+                    if (densityMode)
+                        restartDensity();
+                    else
+                        generatePaths();
+                }
                 break;
             case 27:
+                if (Profiler::instance().isTracing())
+                    toggleTrace();
                 exit(0);
                 break;
         }
     }
+
+    void setWindowSize(int w, int h) {
+        windowWidth = w;
+        windowHeight = h;
+    }
+
+    void screenToWorld(int sx, int sy, double &wx, double &wy) const {
+        wx = -5.0 + 10.0 * sx / windowWidth;
+        wy = 3.0 - 6.0 * sy / windowHeight;
+    }
+
+    // Picks the interior vertex nearest to the cursor on its time slice; the
+    // scan over paths happens once per press, every drag step is O(1). Only
+    // real-time amplitudes can be dragged; Euclidean weights also depend on
+    // the density the path was drawn from.
+    void mousePressed(int sx, int sy) {
+        if (euclidean || densityMode)
+            return;
+
+        double wx, wy;
+        screenToWorld(sx, sy, wx, wy);
+
+        const int steps = paths.timeSteps();
+        int t = (int)std::floor((wy + 2.5) / 5.0 * steps + 0.5);
+        if (t < 1 || t >= steps)
+            return;
+
+        int best = -1;
+        double bestDistance = 0.1;
+        for (int i = 0; i < paths.numPaths(); i++) {
+            double distance = std::fabs(paths.path(i)[t] - wx);
+            if (distance < bestDistance) {
+                best = i;
+                bestDistance = distance;
+            }
+        }
+        if (best < 0)
+            return;
+
+        dragPath = best;
+        dragSite = t;
+        const SimulationParams p = params();
+        dragState.bind(paths.path(best), paths.numSites(), false,
+                       0.5 * p.mass / p.dt, -p.dt, potential);
+    }
+
+    void mouseDragged(int sx, int sy) {
+        if (dragPath < 0)
+            return;
+
+        double wx, wy;
+        screenToWorld(sx, sy, wx, wy);
+        dragState.set(dragSite, wx);
+
+        std::complex<double> oldAmplitude =
+        paths.amplitude(dragPath) * normalization;
+        std::complex<double> newAmplitude =
+        std::exp(std::complex<double>(0, -dragState.action() / params().hbar));
+        paths.actions()[dragPath] = dragState.action();
+        paths.setAmplitude(dragPath, newAmplitude / normalization);
+        amplitudeSum += newAmplitude - oldAmplitude;
+        dirtyPath = dragPath;
+    }
+
+    // The ensemble keeps its old normalization while dragging; renormalize
+    // once the drag ends.
+    void mouseReleased() {
+        if (dragPath < 0)
+            return;
+        dragPath = -1;
+
+        if (std::abs(amplitudeSum) > 1e-10) {
+            std::complex<double> scale = normalization / amplitudeSum;
+            for (int i = 0; i < paths.numPaths(); i++) {
+                paths.setAmplitude(i, paths.amplitude(i) * scale);
+            }
+            normalization = amplitudeSum;
+            geometryDirty = true;
+        }
+    }
 };
 
 PathIntegralSimulation *sim = nullptr;
@@ -239,7 +683,25 @@ void keyboard(unsigned char key, int x, int y) {
         sim->keyPressed(key, x, y);
 }
 
-void reshape(int w, int h) { glViewport(0, 0, w, h); }
+void mouse(int button, int state, int x, int y) {
+    if (!sim || button != GLUT_LEFT_BUTTON)
+        return;
+    if (state == GLUT_DOWN)
+        sim->mousePressed(x, y);
+    else
+        sim->mouseReleased();
+}
+
+void motion(int x, int y) {
+    if (sim)
+        sim->mouseDragged(x, y);
+}
+
+void reshape(int w, int h) {
+    glViewport(0, 0, w, h);
+    if (sim)
+        sim->setWindowSize(w, h);
+}
 
 int main(int argc, char **argv) {
     glutInit(&argc, argv);
@@ -256,22 +718,54 @@ int main(int argc, char **argv) {
     glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
 
     sim = new PathIntegralSimulation();
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--replay") {
+            if (!sim->openReplay(argv[i + 1]))
+                return -1;
+        } else if (isPotentialOption(arg)) {
+            Potential potential = sim->getPotential();
+            std::string error;
+            if (!applyPotentialOption(arg, argv[i + 1], potential, error)) {
+                std::cout << error << std::endl;
+                return -1;
+            }
+            sim->setPotential(potential);
+        }
+    }
+
+    if (!sim->init()) {
+        std::cout << "OpenGL vertex buffer objects are not available!"
+        << std::endl;
+        return -1;
+    }
 
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
+    glutMouseFunc(mouse);
+    glutMotionFunc(motion);
     glutTimerFunc(0, update, 0);
 
     std::cout << "1D Quantum Path Integral Simulation" << std::endl;
     std::cout << "Controls:" << std::endl;
-    std::cout << "  R - Regenerate paths" << std::endl;
+    std::cout << "  R - Regenerate paths (next stored ensemble with --replay)"
+    << std::endl;
+    std::cout << "  Left drag - Move a path vertex" << std::endl;
+    std::cout << "  P - Toggle the profiler overlay" << std::endl;
+    std::cout << "  T - Start/stop recording a trace (" << TRACE_FILE << ")"
+    << std::endl;
+    std::cout << "  E - Toggle Euclidean weights" << std::endl;
+    std::cout << "  D - Toggle density mode (accumulate ensembles into an image)"
+    << std::endl;
     std::cout << "  ESC - Exit" << std::endl;
     std::cout << std::endl;
     std::cout << "Simulation shows quantum paths between red start/end points."
     << std::endl;
     std::cout << "Colors represent quantum amplitudes (phase and magnitude)."
     << std::endl;
-    std::cout << "Blue curve shows harmonic oscillator potential." << std::endl;
+    std::cout << "Blue curve shows the " << sim->getPotential().name()
+    << " potential." << std::endl;
 
     glutMainLoop();
 
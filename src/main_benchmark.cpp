@@ -0,0 +1,332 @@
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "action_kernel.h"
+#include "density_image.h"
+#include "path_ensemble.h"
+#include "path_generator.h"
+#include "path_geometry.h"
+
+// Every heap allocation in the process goes through these counters, so a
+// stage that should reuse its buffers shows up with zero allocations.
+static std::atomic<uint64_t> allocationCount(0);
+static std::atomic<uint64_t> allocationBytes(0);
+
+static void *countedAlloc(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    void *block = std::malloc(size ? size : 1);
+    if (!block)
+        throw std::bad_alloc();
+    return block;
+}
+
+void *operator new(size_t size) { return countedAlloc(size); }
+void *operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void *block) noexcept { std::free(block); }
+void operator delete[](void *block) noexcept { std::free(block); }
+
+struct BenchmarkOptions {
+    std::vector<int> pathCounts;
+    std::vector<int> stepCounts;
+    int threads;
+    double minTime;
+    std::string simd;
+    std::string output;
+    Potential potential;
+
+    BenchmarkOptions()
+    : threads(0), minTime(0.2), output("benchmark_results.json") {}
+};
+
+struct StageResult {
+    std::string stage;
+    int numPaths;
+    int timeSteps;
+    int repetitions;
+    double bestSeconds;
+    double meanSeconds;
+    double allocations;
+    double allocatedBytes;
+};
+
+static void printUsage(const char *program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "  --paths LIST     comma-separated path counts (default 1000,10000,100000)" << std::endl;
+    std::cout << "  --steps LIST     comma-separated time steps (default 50,200)" << std::endl;
+    std::cout << "  --threads N      worker threads, 0 = all cores (default 0)" << std::endl;
+    std::cout << "  --simd LEVEL     scalar, sse2, avx2 or avx512 (default: best)" << std::endl;
+    std::cout << "  --min-time X     seconds spent on each stage (default 0.2)" << std::endl;
+    std::cout << "  --output FILE    JSON results (default benchmark_results.json)" << std::endl;
+    std::cout << "  --potential NAME potential used by the action stages (default harmonic)" << std::endl;
+    std::cout << "  --potential-file FILE  tabulated potential, \"x V\" per line" << std::endl;
+}
+
+static bool parseList(const char *value, std::vector<int> &list) {
+    list.clear();
+    std::stringstream in(value);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        int n = std::atoi(item.c_str());
+        if (n <= 0)
+            return false;
+        list.push_back(n);
+    }
+    return !list.empty();
+}
+
+static bool parseArgs(int argc, char **argv, BenchmarkOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char *value = argv[++i];
+
+        if (arg == "--paths") {
+            if (!parseList(value, options.pathCounts)) {
+                std::cerr << "--paths needs positive integers" << std::endl;
+                return false;
+            }
+        } else if (arg == "--steps") {
+            if (!parseList(value, options.stepCounts)) {
+                std::cerr << "--steps needs positive integers" << std::endl;
+                return false;
+            }
+        } else if (arg == "--threads")
+            options.threads = std::atoi(value);
+        else if (arg == "--simd")
+            options.simd = value;
+        else if (arg == "--min-time")
+            options.minTime = std::atof(value);
+        else if (arg == "--output")
+            options.output = value;
+        else if (isPotentialOption(arg)) {
+            std::string error;
+            if (!applyPotentialOption(arg, value, options.potential, error)) {
+                std::cerr << error << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (options.pathCounts.empty())
+        options.pathCounts = {1000, 10000, 100000};
+    if (options.stepCounts.empty())
+        options.stepCounts = {50, 200};
+    return true;
+}
+
+// Runs body once to warm caches and buffers, then repeatedly until minTime
+// has passed (at least three times), keeping the best and mean wall time.
+static StageResult timeStage(const std::string &stage,
+                             const SimulationParams &params, double minTime,
+                             const std::function<void()> &body) {
+    typedef std::chrono::steady_clock Clock;
+
+    body();
+
+    StageResult result;
+    result.stage = stage;
+    result.numPaths = params.numPaths;
+    result.timeSteps = params.timeSteps;
+    result.repetitions = 0;
+    result.bestSeconds = 0.0;
+
+    uint64_t count = allocationCount.load();
+    uint64_t bytes = allocationBytes.load();
+    double total = 0.0;
+    while (result.repetitions < 3 || total < minTime) {
+        Clock::time_point start = Clock::now();
+        body();
+        double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+        if (result.repetitions == 0 || seconds < result.bestSeconds)
+            result.bestSeconds = seconds;
+        total += seconds;
+        result.repetitions++;
+    }
+
+    result.meanSeconds = total / result.repetitions;
+    result.allocations =
+    (double)(allocationCount.load() - count) / result.repetitions;
+    result.allocatedBytes =
+    (double)(allocationBytes.load() - bytes) / result.repetitions;
+    return result;
+}
+
+static void benchmarkShape(const SimulationParams &params, double minTime,
+                           PathGenerator &generator,
+                           std::vector<StageResult> &results) {
+    const ActionKernel &kernel = actionKernel();
+    const ActionCoefficients coefficients =
+    makeActionCoefficients(params.mass, params.dt);
+
+    PathEnsemble paths;
+    generator.generate(paths, params, 0);
+    AmplitudePalette palette;
+    std::vector<PathColor> colors(paths.numPaths());
+    std::vector<PathVertex> vertices((size_t)paths.numPaths() *
+                                     paths.numSites());
+
+    PathNoise noise(params.seed, 0);
+
+    results.push_back(timeStage("generate_random_path", params, minTime, [&]() {
+        for (int i = 0; i < paths.numPaths(); i++) {
+            generateRandomPath(paths.path(i), params.timeSteps, params.x0,
+                               params.xf, params.sigma, noise, i);
+        }
+    }));
+
+    results.push_back(timeStage("action", params, minTime, [&]() {
+        kernel.computeActions(paths.positions(), paths.stride(),
+                              paths.numPaths(), paths.numSites(), coefficients,
+                              params.potential, paths.actions());
+    }));
+
+    results.push_back(timeStage("phases", params, minTime, [&]() {
+        kernel.computePhases(paths.actions(), paths.numPaths(),
+                             1.0 / params.hbar, paths.amplitudesRe(),
+                             paths.amplitudesIm());
+    }));
+
+    results.push_back(timeStage("normalize", params, minTime, [&]() {
+        std::complex<double> sum(0, 0);
+        for (int i = 0; i < paths.numPaths(); i++) {
+            sum += paths.amplitude(i);
+        }
+        if (std::abs(sum) > 1e-10) {
+            const std::complex<double> scale = 1.0 / sum;
+            for (int i = 0; i < paths.numPaths(); i++) {
+                paths.setAmplitude(i, paths.amplitude(i) * scale);
+            }
+        }
+    }));
+
+    results.push_back(timeStage("colors", params, minTime, [&]() {
+        palette.colorEnsemble(paths, generator.pool(), colors.data());
+    }));
+
+    results.push_back(timeStage("geometry", params, minTime, [&]() {
+        buildEnsembleVertices(paths, colors.data(), generator.pool(),
+                              vertices.data());
+    }));
+
+    DensityImage density(512, 256, -5.0, 5.0);
+    results.push_back(timeStage("density", params, minTime, [&]() {
+        density.accumulate(paths, palette, generator.pool());
+    }));
+
+    uint64_t stream = 0;
+    results.push_back(timeStage("generate_ensemble", params, minTime, [&]() {
+        generator.generate(paths, params, stream++);
+    }));
+}
+
+static void writeJson(std::ostream &out, const BenchmarkOptions &options,
+                      int threads, const std::vector<StageResult> &results) {
+    out << std::setprecision(9);
+    out << "{\n";
+    out << "  \"kernel\": \"" << actionKernel().name << "\",\n";
+    out << "  \"threads\": " << threads << ",\n";
+    out << "  \"potential\": \"" << options.potential.name() << "\",\n";
+    out << "  \"min_time\": " << options.minTime << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const StageResult &r = results[i];
+        double sites = (double)r.numPaths * (r.timeSteps + 1);
+        out << "    {\"stage\": \"" << r.stage << "\", \"paths\": " << r.numPaths
+        << ", \"time_steps\": " << r.timeSteps
+        << ", \"repetitions\": " << r.repetitions
+        << ", \"best_seconds\": " << r.bestSeconds
+        << ", \"mean_seconds\": " << r.meanSeconds
+        << ", \"paths_per_second\": " << r.numPaths / r.bestSeconds
+        << ", \"ns_per_site\": " << r.bestSeconds * 1e9 / sites
+        << ", \"allocations\": " << r.allocations
+        << ", \"allocated_bytes\": " << r.allocatedBytes << "}"
+        << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+int main(int argc, char **argv) {
+    BenchmarkOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (!options.simd.empty()) {
+        SimdLevel level;
+        if (!parseSimdLevel(options.simd.c_str(), level)) {
+            std::cerr << "Unknown SIMD level " << options.simd << std::endl;
+            return 1;
+        }
+        setSimdLevel(level);
+    }
+
+    PathGenerator generator(options.threads);
+
+    std::cout << "1D Quantum Path Integral Simulation - Benchmark" << std::endl;
+    std::cout << "  " << actionKernel().name << " kernel, "
+    << generator.numThreads() << " thread(s), " << options.potential.name()
+    << " potential" << std::endl;
+    std::cout << std::left << std::setw(22) << "  stage" << std::right
+    << std::setw(9) << "paths" << std::setw(7) << "steps" << std::setw(14)
+    << "paths/s" << std::setw(11) << "ns/site" << std::setw(9) << "allocs"
+    << std::endl;
+
+    std::vector<StageResult> results;
+    for (size_t s = 0; s < options.stepCounts.size(); s++) {
+        for (size_t p = 0; p < options.pathCounts.size(); p++) {
+            SimulationParams params;
+            params.numPaths = options.pathCounts[p];
+            params.timeSteps = options.stepCounts[s];
+            params.potential = options.potential;
+
+            size_t first = results.size();
+            benchmarkShape(params, options.minTime, generator, results);
+
+            for (size_t i = first; i < results.size(); i++) {
+                const StageResult &r = results[i];
+                double sites = (double)r.numPaths * (r.timeSteps + 1);
+                std::cout << "  " << std::left << std::setw(20) << r.stage
+                << std::right << std::setw(9) << r.numPaths << std::setw(7)
+                << r.timeSteps << std::setw(14) << std::setprecision(4)
+                << r.numPaths / r.bestSeconds << std::setw(11)
+                << r.bestSeconds * 1e9 / sites << std::setw(9)
+                << r.allocations << std::endl;
+            }
+        }
+    }
+
+    std::ofstream out(options.output.c_str());
+    if (!out) {
+        std::cerr << "Cannot open " << options.output << std::endl;
+        return 1;
+    }
+    writeJson(out, options, generator.numThreads(), results);
+    std::cout << "  Results written to " << options.output << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,1136 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "accumulators.h"
+#include "action_kernel.h"
+#include "checkpoint.h"
+#include "ensemble_file.h"
+#include "metropolis.h"
+#include "observables.h"
+#include "path_ensemble.h"
+#include "path_generator.h"
+#include "process_group.h"
+#include "transfer_matrix.h"
+
+static const double PI = 3.14159265358979323846;
+
+struct HeadlessOptions {
+    SimulationParams params;
+    int ensembles;
+    int batch;
+    int threads;
+    int workers;
+    std::string output;
+    std::string pathsCsv;
+    std::string binaryOut;
+    PositionPrecision precision;
+    std::string simd;
+    std::string sampler;
+    int sweeps;
+    int thermalize;
+    double stepSize;
+    int levels;
+    int leapfrog;
+    double fourierMass;
+    int continuum;
+    bool periodic;
+    int latticeSize;
+    double dx;
+    std::string densityCsv;
+    std::string histogramCsv;
+    std::string checkpoint;
+    double checkpointEvery;
+    std::string resume;
+    // The command line minus --resume, stored in checkpoints.
+    std::vector<std::string> args;
+
+    HeadlessOptions()
+    : ensembles(1), batch(0), threads(0), workers(1), output("path_integral_results.csv"),
+    precision(POSITIONS_FLOAT64), sampler("gaussian"), sweeps(10000), thermalize(1000), stepSize(0.0),
+    levels(0), leapfrog(10), fourierMass(1.0), continuum(0), periodic(true), latticeSize(100), dx(0.1), checkpointEvery(300.0) {}
+};
+
+static void printUsage(const char *program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "  --paths N        paths per ensemble (default 1000)" << std::endl;
+    std::cout << "  --steps N        time steps per path (default 50)" << std::endl;
+    std::cout << "  --hbar X         reduced Planck constant (default 1.0)" << std::endl;
+    std::cout << "  --mass X         particle mass (default 1.0)" << std::endl;
+    std::cout << "  --dt X           time step size (default 0.1)" << std::endl;
+    std::cout << "  --x0 X           start position (default -2.0)" << std::endl;
+    std::cout << "  --xf X           end position (default 2.0)" << std::endl;
+    std::cout << "  --sigma X        path fluctuation width (default 0.5)" << std::endl;
+    std::cout << "  --seed N         RNG seed (default 42)" << std::endl;
+    std::cout << "  --ensembles N    number of ensembles to run (default 1)" << std::endl;
+    std::cout << "  --batch N        paths held in memory at once (default: whole ensemble)" << std::endl;
+    std::cout << "  --threads N      worker threads, 0 = all cores (default 0)" << std::endl;
+    std::cout << "  --workers N      split gaussian ensembles over N local processes (default 1)" << std::endl;
+    std::cout << "  --simd LEVEL     scalar, sse2, avx2 or avx512 (default: best)" << std::endl;
+    std::cout << "  --output FILE    per-ensemble summary CSV" << std::endl;
+    std::cout << "  --paths-csv FILE also write every sampled path as CSV" << std::endl;
+    std::cout << "  --binary-out FILE archive every ensemble in the binary ensemble format" << std::endl;
+    std::cout << "  --precision P    float32 or float64 positions in --binary-out (default float64)" << std::endl;
+    std::cout << "  --time MODE      real (phases) or euclidean (weights) for gaussian paths (default real)" << std::endl;
+    std::cout << "  --histogram FILE write the sampled |psi_0|^2 histogram with jackknife errors" << std::endl;
+    std::cout << "  --sampler NAME   gaussian, metropolis, heatbath, bisection, hmc or transfer" << std::endl;
+    std::cout << "                   (default gaussian)" << std::endl;
+    std::cout << "  --sweeps N       measurement sweeps per chain (default 10000)" << std::endl;
+    std::cout << "  --thermalize N   sweeps discarded before measuring (default 1000)" << std::endl;
+    std::cout << "  --step X         Metropolis half-width or hmc leapfrog step (default auto)" << std::endl;
+    std::cout << "  --levels L       bisection segments of 2^L links (default: about one time unit)" << std::endl;
+    std::cout << "  --leapfrog N     leapfrog steps per hmc trajectory (default 10)" << std::endl;
+    std::cout << "  --fourier-mass C hmc mass-matrix curvature, 0 = unit masses (default 1)" << std::endl;
+    std::cout << "  --continuum K    run chains at dt, dt/2, ... dt/2^(K-1) over the same time and" << std::endl;
+    std::cout << "                   extrapolate <x^2> and E0 to dt -> 0" << std::endl;
+    std::cout << "  --boundary B     periodic or fixed endpoints for chains (default periodic)" << std::endl;
+    std::cout << "  --lattice N      transfer-matrix grid sites (default 100)" << std::endl;
+    std::cout << "  --dx X           transfer-matrix grid spacing (default 0.1)" << std::endl;
+    std::cout << "  --density-csv FILE  write the transfer-matrix |psi_0|^2 on the grid" << std::endl;
+    std::cout << "  --checkpoint FILE     periodically save the run state to FILE" << std::endl;
+    std::cout << "  --checkpoint-every S  seconds between checkpoints (default 300)" << std::endl;
+    std::cout << "  --resume FILE    continue the run saved in FILE (only --threads and" << std::endl;
+    std::cout << "                   --checkpoint-every may change)" << std::endl;
+    std::cout << "  --potential NAME harmonic, anharmonic, doublewell, squarewell or morse" << std::endl;
+    std::cout << "  --potential-file FILE  tabulated potential, \"x V\" per line (cubic spline)" << std::endl;
+    std::cout << "  --potential-params A,B,C  shape parameters (see potential.h)" << std::endl;
+}
+
+static bool parseArgs(int argc, char **argv, HeadlessOptions &options) {
+    SimulationParams &p = options.params;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char *value = argv[++i];
+        if (arg != "--resume") {
+            options.args.push_back(arg);
+            options.args.push_back(value);
+        }
+
+        if (arg == "--paths")
+            p.numPaths = std::atoi(value);
+        else if (arg == "--steps")
+            p.timeSteps = std::atoi(value);
+        else if (arg == "--hbar")
+            p.hbar = std::atof(value);
+        else if (arg == "--mass")
+            p.mass = std::atof(value);
+        else if (arg == "--dt")
+            p.dt = std::atof(value);
+        else if (arg == "--x0")
+            p.x0 = std::atof(value);
+        else if (arg == "--xf")
+            p.xf = std::atof(value);
+        else if (arg == "--sigma")
+            p.sigma = std::atof(value);
+        else if (arg == "--seed")
+            p.seed = std::strtoull(value, nullptr, 10);
+        else if (arg == "--ensembles")
+            options.ensembles = std::atoi(value);
+        else if (arg == "--batch")
+            options.batch = std::atoi(value);
+        else if (arg == "--threads")
+            options.threads = std::atoi(value);
+        else if (arg == "--workers")
+            options.workers = std::atoi(value);
+        else if (arg == "--simd")
+            options.simd = value;
+        else if (arg == "--output")
+            options.output = value;
+        else if (arg == "--paths-csv")
+            options.pathsCsv = value;
+        else if (arg == "--binary-out")
+            options.binaryOut = value;
+        else if (arg == "--precision") {
+            if (std::strcmp(value, "float32") == 0)
+                options.precision = POSITIONS_FLOAT32;
+            else if (std::strcmp(value, "float64") == 0)
+                options.precision = POSITIONS_FLOAT64;
+            else {
+                std::cerr << "Unknown precision " << value << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--time") {
+            if (std::strcmp(value, "real") == 0)
+                p.euclidean = false;
+            else if (std::strcmp(value, "euclidean") == 0)
+                p.euclidean = true;
+            else {
+                std::cerr << "Unknown time mode " << value << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--histogram")
+            options.histogramCsv = value;
+        else if (arg == "--sampler")
+            options.sampler = value;
+        else if (arg == "--sweeps")
+            options.sweeps = std::atoi(value);
+        else if (arg == "--thermalize")
+            options.thermalize = std::atoi(value);
+        else if (arg == "--step")
+            options.stepSize = std::atof(value);
+        else if (arg == "--levels")
+            options.levels = std::atoi(value);
+        else if (arg == "--leapfrog")
+            options.leapfrog = std::atoi(value);
+        else if (arg == "--fourier-mass")
+            options.fourierMass = std::atof(value);
+        else if (arg == "--continuum")
+            options.continuum = std::atoi(value);
+        else if (arg == "--boundary") {
+            if (std::strcmp(value, "periodic") == 0)
+                options.periodic = true;
+            else if (std::strcmp(value, "fixed") == 0)
+                options.periodic = false;
+            else {
+                std::cerr << "Unknown boundary " << value << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--lattice")
+            options.latticeSize = std::atoi(value);
+        else if (arg == "--dx")
+            options.dx = std::atof(value);
+        else if (arg == "--density-csv")
+            options.densityCsv = value;
+        else if (arg == "--checkpoint")
+            options.checkpoint = value;
+        else if (arg == "--checkpoint-every")
+            options.checkpointEvery = std::atof(value);
+        else if (arg == "--resume")
+            options.resume = value;
+        else if (isPotentialOption(arg)) {
+            std::string error;
+            if (!applyPotentialOption(arg, value, p.potential, error)) {
+                std::cerr << error << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (p.numPaths <= 0 || p.timeSteps <= 0 || options.ensembles <= 0) {
+        std::cerr << "--paths, --steps and --ensembles must be positive" << std::endl;
+        return false;
+    }
+    if (p.hbar <= 0 || p.mass <= 0 || p.dt <= 0) {
+        std::cerr << "--hbar, --mass and --dt must be positive" << std::endl;
+        return false;
+    }
+    if (options.sampler != "gaussian" && options.sampler != "metropolis" &&
+        options.sampler != "heatbath" && options.sampler != "bisection" &&
+        options.sampler != "hmc" && options.sampler != "transfer") {
+        std::cerr << "Unknown sampler " << options.sampler << std::endl;
+        return false;
+    }
+    if (options.sweeps <= 0 || options.thermalize < 0) {
+        std::cerr << "--sweeps must be positive" << std::endl;
+        return false;
+    }
+    if ((options.sampler == "bisection" || options.sampler == "hmc") &&
+        p.timeSteps < 3) {
+        std::cerr << "--sampler " << options.sampler
+        << " needs at least 3 --steps" << std::endl;
+        return false;
+    }
+    if (options.leapfrog < 1 || options.fourierMass < 0) {
+        std::cerr << "--leapfrog must be positive and --fourier-mass non-negative"
+        << std::endl;
+        return false;
+    }
+    if (options.continuum != 0) {
+        const char *problem = nullptr;
+        if (options.continuum < 2)
+            problem = "--continuum needs at least 2 levels";
+        else if (options.sampler == "gaussian" || options.sampler == "transfer")
+            problem = "--continuum needs a Markov-chain --sampler";
+        else if (options.ensembles > 1 || !options.histogramCsv.empty())
+            problem = "--continuum runs one chain per level; drop --ensembles and --histogram";
+        else if (!options.checkpoint.empty())
+            problem = "--continuum runs cannot be checkpointed";
+        if (problem) {
+            std::cerr << problem << std::endl;
+            return false;
+        }
+    }
+    if (options.latticeSize < 2 || options.dx <= 0) {
+        std::cerr << "--lattice must be at least 2 and --dx positive" << std::endl;
+        return false;
+    }
+    if (!options.checkpoint.empty() && !options.binaryOut.empty()) {
+        std::cerr << "--binary-out runs cannot be checkpointed" << std::endl;
+        return false;
+    }
+    if (options.workers < 1) {
+        std::cerr << "--workers must be positive" << std::endl;
+        return false;
+    }
+    if (options.workers > 1 && options.threads == 0)
+        options.threads = std::max(1, ThreadPool::defaultThreadCount() / options.workers);
+    if (options.checkpointEvery < 0) {
+        std::cerr << "--checkpoint-every must not be negative" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Swaps in the options stored in the checkpoint being resumed, keeping only
+// --threads and --checkpoint-every from the command line, and leaves `in`
+// positioned after the stored command line and kernel name.
+static bool resumeOptions(HeadlessOptions &options, CheckpointReader &in) {
+    if (!in.open(options.resume)) {
+        std::cerr << "Cannot resume: " << in.error() << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> args(1, "resume");
+    uint64_t count = in.get<uint64_t>();
+    for (uint64_t i = 0; i < count && in.ok(); i++) {
+        args.push_back(in.getString());
+    }
+    std::string kernel = in.getString();
+    if (!in.ok()) {
+        std::cerr << "Cannot resume: " << in.error() << std::endl;
+        return false;
+    }
+
+    std::vector<char *> argvStored;
+    for (size_t i = 0; i < args.size(); i++) {
+        argvStored.push_back(&args[i][0]);
+    }
+    HeadlessOptions stored;
+    if (!parseArgs((int)argvStored.size(), argvStored.data(), stored))
+        return false;
+
+    stored.threads = options.threads;
+    stored.checkpointEvery = options.checkpointEvery;
+    stored.checkpoint = options.resume;
+    stored.resume = options.resume;
+    // Lanes of different widths round differently, so stay on the kernel the
+    // run started with.
+    stored.simd = kernel;
+    options = stored;
+    return true;
+}
+
+static bool checkpointDue(const HeadlessOptions &options,
+                          std::chrono::steady_clock::time_point &last) {
+    if (options.checkpoint.empty())
+        return false;
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - last).count() < options.checkpointEvery)
+        return false;
+    last = now;
+    return true;
+}
+
+// Common checkpoint header: the command line, the kernel, the time spent so
+// far and how many bytes of each output file the saved state accounts for.
+static void beginCheckpoint(CheckpointWriter &out, const HeadlessOptions &options,
+                            double seconds, std::ofstream &summary,
+                            std::ofstream *pathsOut) {
+    out.put<uint64_t>(options.args.size());
+    for (size_t i = 0; i < options.args.size(); i++) {
+        out.putString(options.args[i]);
+    }
+    out.putString(actionKernel().name);
+    out.put<double>(seconds);
+
+    summary.flush();
+    out.put<uint64_t>((uint64_t)summary.tellp());
+    if (pathsOut && pathsOut->is_open()) {
+        pathsOut->flush();
+        out.put<uint64_t>((uint64_t)pathsOut->tellp());
+    } else {
+        out.put<uint64_t>(0);
+    }
+}
+
+static void commitCheckpoint(CheckpointWriter &out, const HeadlessOptions &options) {
+    if (!out.commit(options.checkpoint)) {
+        std::cerr << "  warning: checkpoint not saved: " << out.error()
+        << std::endl;
+    }
+}
+
+// Reopens an output file for appending after cutting it back to the length
+// recorded in the checkpoint.
+static bool reopenOutput(std::ofstream &out, const std::string &path,
+                         uint64_t bytes) {
+    if (!truncateFile(path, bytes)) {
+        std::cerr << "Cannot resume: " << path
+        << " is missing or shorter than the checkpoint expects" << std::endl;
+        return false;
+    }
+    out.open(path.c_str(), std::ios::out | std::ios::app);
+    if (!out) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool writeHistogram(const std::string &path,
+                           const GroundStateObservables &observables) {
+    std::ofstream out(path.c_str());
+    if (!out) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+    std::vector<Estimate> density;
+    observables.density(density);
+    out << std::setprecision(17) << "x,density,error\n";
+    for (int b = 0; b < observables.histogramBins(); b++) {
+        out << observables.binCenter(b) << "," << density[b].mean << ","
+        << density[b].error << "\n";
+    }
+    return true;
+}
+
+// Applies the chain options to a sampler whose dt is --dt halved
+// `refinement` times. The step sizes and bisection depth given on the command
+// line are for --dt and shrink with the spacing, except the Fourier
+// accelerated leapfrog step, which does not depend on it.
+static void configureSampler(MetropolisSampler &sampler,
+                             const HeadlessOptions &options, int refinement,
+                             bool announce) {
+    const double shrink = std::sqrt(std::ldexp(1.0, -refinement));
+    if (options.sampler == "heatbath")
+        sampler.setMethod(MetropolisSampler::HEAT_BATH);
+    if (options.sampler == "bisection")
+        sampler.setMethod(MetropolisSampler::BISECTION);
+    if (options.levels > 0)
+        sampler.setLevels(options.levels + refinement);
+    if (announce && options.sampler == "bisection") {
+        std::cout << "  segments of " << (1 << sampler.getLevels())
+        << " links (" << sampler.getLevels() << " levels)" << std::endl;
+    }
+    if (options.sampler == "hmc") {
+        sampler.setMethod(MetropolisSampler::HYBRID);
+        double step = options.fourierMass > 0 ? options.stepSize
+                                              : options.stepSize * shrink;
+        sampler.setTrajectory(options.leapfrog, step, options.fourierMass);
+        if (announce) {
+            std::cout << "  trajectories of " << sampler.getLeapfrogSteps()
+            << " leapfrog steps of " << sampler.getLeapfrogStep()
+            << (sampler.getFourierMass() > 0 ? ", Fourier accelerated" : "")
+            << std::endl;
+        }
+    } else if (options.stepSize > 0) {
+        sampler.setStepSize(options.stepSize * shrink);
+    }
+}
+
+static int runMarkovChains(const HeadlessOptions &options,
+                           std::ofstream &summary, CheckpointReader *resume,
+                           double priorSeconds) {
+    const SimulationParams &params = options.params;
+
+    if (!resume) {
+        summary << "chain,sites,sweeps,acceptance,x2_mean,x2_error,energy_mean,"
+        "energy_error,x2_tau\n";
+    }
+
+    std::cout << "  " << options.ensembles << " " << options.sampler
+    << " chain(s), " << params.timeSteps << " sites, "
+    << params.potential.name() << " potential, "
+    << options.thermalize << " + " << options.sweeps << " sweeps"
+    << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    auto lastCheckpoint = start;
+
+    GroundStateObservables all(params.potential,
+                               (uint64_t)options.ensembles * options.sweeps);
+    int firstChain = 0;
+    if (resume) {
+        firstChain = resume->get<int32_t>();
+        all.load(*resume);
+    }
+
+    const int totalSweeps = options.thermalize + options.sweeps;
+    for (int e = firstChain; e < options.ensembles; e++) {
+        MetropolisSampler sampler(params, options.periodic, e);
+        configureSampler(sampler, options, 0, e == firstChain);
+
+        // Pinned endpoints are not sampled, so only interior sites count.
+        const int begin = sampler.isPeriodic() ? 0 : 1;
+        const int end = sampler.isPeriodic() ? sampler.numSites()
+                                             : sampler.numSites() - 1;
+
+        GroundStateObservables chain(params.potential, options.sweeps);
+        BinningAnalysis x2Series;
+        int done = 0;
+        if (resume && e == firstChain) {
+            done = resume->get<int32_t>();
+            chain.load(*resume);
+            x2Series.load(*resume);
+            if (!sampler.load(*resume) || !resume->ok()) {
+                std::cerr << "Cannot resume: " << resume->error() << std::endl;
+                return 1;
+            }
+        }
+
+        for (int i = done; i < totalSweeps; i++) {
+            sampler.sweep();
+            if (i >= options.thermalize) {
+                chain.add(sampler.path(), begin, end);
+                all.add(sampler.path(), begin, end);
+                x2Series.add(sampler.meanX2());
+            }
+
+            if ((i & 63) == 63 && checkpointDue(options, lastCheckpoint)) {
+                double seconds = priorSeconds + std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                .count();
+                CheckpointWriter out;
+                beginCheckpoint(out, options, seconds, summary, nullptr);
+                out.put<int32_t>(e);
+                all.save(out);
+                out.put<int32_t>(i + 1);
+                chain.save(out);
+                x2Series.save(out);
+                sampler.save(out);
+                commitCheckpoint(out, options);
+            }
+        }
+
+        Estimate x2 = chain.x2();
+        Estimate energy = chain.energy();
+
+        summary << e << "," << sampler.numSites() << "," << options.sweeps << ","
+        << sampler.acceptanceRate() << "," << x2.mean << "," << x2.error << ","
+        << energy.mean << "," << energy.error << ","
+        << x2Series.autocorrelationTime() << "\n";
+
+        std::cout << "  chain " << e << ": <x^2> = " << x2.mean << " +/- "
+        << x2.error << ", E0 = " << energy.mean << " +/- " << energy.error
+        << ", acceptance " << sampler.acceptanceRate() << ", tau "
+        << x2Series.autocorrelationTime() << " sweeps" << std::endl;
+    }
+
+    if (!options.histogramCsv.empty() &&
+        !writeHistogram(options.histogramCsv, all))
+        return 1;
+
+    double seconds = priorSeconds + std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start)
+    .count();
+    double updates = (double)options.ensembles *
+    (options.thermalize + options.sweeps) * params.timeSteps;
+
+    std::cout << "  " << updates << " site updates in " << seconds << " s ("
+    << updates / seconds << " updates/s)" << std::endl;
+    std::cout << "  Results written to " << options.output << std::endl;
+
+    return 0;
+}
+
+// One chain per lattice spacing dt / 2^k, k < K, all over the same imaginary
+// time. Level k starts from level k - 1's thermalized path prolonged to the
+// finer lattice, so only the new short-wavelength modes need thermalizing
+// (a quarter of --thermalize); the measurement sweeps of all levels then run
+// in parallel. The primitive action is accurate to O(dt^2), so <x^2> and E0
+// are fitted linearly in dt^2 and the intercept is the continuum value.
+static int runContinuumLimit(const HeadlessOptions &options,
+                             std::ofstream &summary) {
+    const int K = options.continuum;
+    ThreadPool pool(options.threads);
+
+    std::cout << "  " << options.sampler << " chains at " << K
+    << " lattice spacings from dt " << options.params.dt << " to "
+    << std::ldexp(options.params.dt, 1 - K) << ", T = "
+    << options.params.timeSteps * options.params.dt << ", "
+    << options.params.potential.name() << " potential, " << options.sweeps
+    << " sweeps each" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<SimulationParams> params(K, options.params);
+    std::vector<MetropolisSampler *> samplers(K, nullptr);
+    for (int k = 0; k < K; k++) {
+        params[k].dt = std::ldexp(options.params.dt, -k);
+        params[k].timeSteps = options.params.timeSteps << k;
+        samplers[k] = new MetropolisSampler(params[k], options.periodic, k);
+        configureSampler(*samplers[k], options, k, k == 0);
+
+        int thermalize = options.thermalize;
+        if (k > 0) {
+            samplers[k]->prolongFrom(*samplers[k - 1]);
+            thermalize = options.thermalize / 4;
+        }
+        for (int i = 0; i < thermalize; i++) {
+            samplers[k]->sweep();
+        }
+    }
+
+    std::vector<Estimate> x2(K), energy(K);
+    std::vector<double> acceptance(K), tau(K);
+    // Finest (slowest) levels first, so the coarse ones fill in around them.
+    pool.parallelFor(K, [&](int task) {
+        const int k = K - 1 - task;
+        MetropolisSampler &sampler = *samplers[k];
+        const int begin = sampler.isPeriodic() ? 0 : 1;
+        const int end = sampler.isPeriodic() ? sampler.numSites()
+                                             : sampler.numSites() - 1;
+
+        GroundStateObservables chain(params[k].potential, options.sweeps);
+        BinningAnalysis x2Series;
+        for (int i = 0; i < options.sweeps; i++) {
+            sampler.sweep();
+            chain.add(sampler.path(), begin, end);
+            x2Series.add(sampler.meanX2());
+        }
+        x2[k] = chain.x2();
+        energy[k] = chain.energy();
+        acceptance[k] = sampler.acceptanceRate();
+        tau[k] = x2Series.autocorrelationTime();
+    });
+
+    std::vector<double> dt2(K);
+    double updates = 0.0;
+    summary << "dt,time_steps,acceptance,x2_mean,x2_error,energy_mean,"
+    "energy_error,x2_tau\n";
+    for (int k = 0; k < K; k++) {
+        dt2[k] = params[k].dt * params[k].dt;
+        updates += (double)options.sweeps * samplers[k]->numSites();
+        summary << params[k].dt << "," << params[k].timeSteps << ","
+        << acceptance[k] << "," << x2[k].mean << "," << x2[k].error << ","
+        << energy[k].mean << "," << energy[k].error << "," << tau[k] << "\n";
+
+        std::cout << "  dt " << params[k].dt << ": <x^2> = " << x2[k].mean
+        << " +/- " << x2[k].error << ", E0 = " << energy[k].mean << " +/- "
+        << energy[k].error << ", acceptance " << acceptance[k] << ", tau "
+        << tau[k] << " sweeps" << std::endl;
+        delete samplers[k];
+    }
+
+    LineFit x2Fit = fitLine(dt2, x2);
+    LineFit energyFit = fitLine(dt2, energy);
+    summary << "0,,," << x2Fit.intercept.mean << ","
+    << x2Fit.intercept.error << "," << energyFit.intercept.mean << ","
+    << energyFit.intercept.error << ",\n";
+
+    std::cout << "  dt -> 0: <x^2> = " << x2Fit.intercept.mean << " +/- "
+    << x2Fit.intercept.error << " (slope " << x2Fit.slope.mean << " +/- "
+    << x2Fit.slope.error << " per dt^2";
+    if (x2Fit.dof > 0)
+        std::cout << ", chi2/dof " << x2Fit.chi2 / x2Fit.dof;
+    std::cout << ")" << std::endl;
+    std::cout << "           E0 = " << energyFit.intercept.mean << " +/- "
+    << energyFit.intercept.error << " (slope " << energyFit.slope.mean
+    << " +/- " << energyFit.slope.error << " per dt^2";
+    if (energyFit.dof > 0)
+        std::cout << ", chi2/dof " << energyFit.chi2 / energyFit.dof;
+    std::cout << ")" << std::endl;
+
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start)
+    .count();
+    std::cout << "  " << updates << " measured site updates in " << seconds
+    << " s on " << pool.size() << " thread(s)" << std::endl;
+    std::cout << "  Results written to " << options.output << std::endl;
+    return 0;
+}
+
+// Exact answers on the lattice: ground state from the one-step Euclidean
+// matrix, and the Euclidean and real-time kernels between the endpoints over
+// the full time by repeated squaring.
+static int runTransferMatrix(const HeadlessOptions &options,
+                             std::ofstream &summary) {
+    const SimulationParams &params = options.params;
+    ThreadPool pool(options.threads);
+    TransferMatrix matrix(options.latticeSize, options.dx);
+
+    std::cout << "  transfer matrix, " << matrix.size() << " sites x dx "
+    << matrix.spacing() << ", " << params.timeSteps << " steps of dt "
+    << params.dt << ", " << params.potential.name() << " potential" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+
+    matrix.build(params, TransferMatrix::EUCLIDEAN);
+    std::vector<double> density;
+    double e0 = matrix.groundState(density);
+    double x2 = matrix.meanX2(density);
+    matrix.propagate(params.timeSteps, pool);
+    double euclidean = matrix.propagator(params.xf, params.x0).real();
+
+    if (matrix.phaseStep(params) > PI) {
+        std::cout << "  warning: the grid does not resolve the real-time phase ("
+        << matrix.phaseStep(params) << " rad per site); use a smaller --dx or --lattice"
+        << std::endl;
+    }
+    matrix.build(params, TransferMatrix::REAL_TIME);
+    matrix.propagate(params.timeSteps, pool);
+    std::complex<double> kernel = matrix.propagator(params.xf, params.x0);
+
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start)
+    .count();
+
+    summary << "lattice,dx,time_steps,dt,e0,x2_mean,euclidean_kernel,kernel_re,"
+    "kernel_im,kernel_abs\n";
+    summary << matrix.size() << "," << matrix.spacing() << "," << params.timeSteps
+    << "," << params.dt << "," << e0 << "," << x2 << "," << euclidean << ","
+    << kernel.real() << "," << kernel.imag() << "," << std::abs(kernel) << "\n";
+
+    if (!options.densityCsv.empty()) {
+        std::ofstream out(options.densityCsv.c_str());
+        if (!out) {
+            std::cerr << "Cannot open " << options.densityCsv << std::endl;
+            return 1;
+        }
+        out << std::setprecision(17) << "x,density\n";
+        for (int i = 0; i < matrix.size(); i++) {
+            out << matrix.position(i) << "," << density[i] << "\n";
+        }
+    }
+
+    std::cout << "  E0 = " << e0 << ", <x^2> = " << x2 << std::endl;
+    std::cout << "  K_E(xf, x0) = " << euclidean << ", K(xf, x0) = " << kernel
+    << std::endl;
+    std::cout << "  done in " << seconds << " s" << std::endl;
+    std::cout << "  Results written to " << options.output << std::endl;
+
+    return 0;
+}
+
+static void writePaths(std::ofstream &out, int ensemble, int firstPath,
+                       const PathEnsemble &paths) {
+    for (int i = 0; i < paths.numPaths(); i++) {
+        const double *path = paths.path(i);
+        out << ensemble << "," << firstPath + i << "," << paths.actions()[i] << ","
+        << paths.amplitudesRe()[i] << "," << paths.amplitudesIm()[i];
+        for (int t = 0; t < paths.numSites(); t++) {
+            out << "," << path[t];
+        }
+        out << "\n";
+    }
+}
+
+// Per-ensemble sums of the Gaussian sampler. Euclidean batch sums are
+// relative to each batch's largest weight, so weightSum is kept relative to
+// the largest log-scale seen so far.
+struct EnsembleSums {
+    RunningStats actions;
+    ComplexSum amplitudes;
+    double logScale;
+    double weightSum;
+
+    EnsembleSums() : logScale(-HUGE_VAL), weightSum(0.0) {}
+
+    void addWeights(double scale, double sum) {
+        if (scale == -HUGE_VAL)
+            return;
+        if (scale > logScale) {
+            weightSum *= std::exp(logScale - scale);
+            logScale = scale;
+        }
+        weightSum += sum * std::exp(scale - logScale);
+    }
+
+    void merge(const EnsembleSums &other) {
+        actions.merge(other.actions);
+        amplitudes.merge(other.amplitudes);
+        addWeights(other.logScale, other.weightSum);
+    }
+
+    void save(CheckpointWriter &out) const {
+        actions.save(out);
+        amplitudes.save(out);
+        out.put<double>(logScale);
+        out.put<double>(weightSum);
+    }
+
+    void load(CheckpointReader &in) {
+        actions.load(in);
+        amplitudes.load(in);
+        logScale = in.get<double>();
+        weightSum = in.get<double>();
+    }
+};
+
+// Rank 0 folds every other rank's partial sums and observables for the
+// ensemble into its own. The other ranks send theirs and start afresh.
+static bool reduceEnsemble(ProcessGroup &group, EnsembleSums &sums,
+                           GroundStateObservables &observables) {
+    if (!group.isCoordinator()) {
+        CheckpointWriter out;
+        sums.save(out);
+        observables.save(out);
+        observables.clear();
+        return group.send(out.serialize());
+    }
+
+    GroundStateObservables partial = observables;
+    for (int r = 1; r < group.size(); r++) {
+        std::vector<unsigned char> message;
+        CheckpointReader in;
+        if (!group.receive(r, message) ||
+            !in.parse(message, "rank " + std::to_string(r)))
+            return false;
+        EnsembleSums other;
+        other.load(in);
+        partial.load(in);
+        if (!in.ok())
+            return false;
+        sums.merge(other);
+        observables.merge(partial);
+    }
+    return true;
+}
+
+static int runGaussianEnsembles(const HeadlessOptions &options,
+                                std::ofstream &summary, CheckpointReader *resume,
+                                double priorSeconds, uint64_t pathsBytes,
+                                ProcessGroup &group) {
+    const SimulationParams &params = options.params;
+    const bool coordinator = group.isCoordinator();
+
+    if (!resume && coordinator) {
+        summary << "ensemble,paths,time_steps,sum_re,sum_im,sum_abs,mean_action,"
+        "stddev_action,min_action,max_action";
+        if (params.euclidean)
+            summary << ",effective_samples,x2_mean,x2_error,energy_mean,energy_error";
+        summary << "\n";
+    }
+
+    std::ofstream pathsOut;
+    if (!options.pathsCsv.empty() && resume) {
+        if (!reopenOutput(pathsOut, options.pathsCsv, pathsBytes))
+            return 1;
+        pathsOut << std::setprecision(17);
+    } else if (!options.pathsCsv.empty()) {
+        pathsOut.open(options.pathsCsv.c_str());
+        if (!pathsOut) {
+            std::cerr << "Cannot open " << options.pathsCsv << std::endl;
+            return 1;
+        }
+        pathsOut << std::setprecision(17);
+        pathsOut << "ensemble,path,action,amplitude_re,amplitude_im,x[0..]\n";
+    }
+
+    EnsembleFileWriter archive;
+    if (!options.binaryOut.empty() &&
+        !archive.open(options.binaryOut, params, options.precision)) {
+        std::cerr << "Cannot open " << options.binaryOut << ": "
+        << archive.error() << std::endl;
+        return 1;
+    }
+
+    PathGenerator generator(options.threads);
+    PathEnsemble paths;
+
+    if (coordinator) {
+        std::cout << "1D Quantum Path Integral Simulation - Headless" << std::endl;
+        std::cout << "  " << params.numPaths << " paths x " << params.timeSteps
+        << " steps, " << options.ensembles << " ensemble(s), ";
+        if (group.size() > 1)
+            std::cout << group.size() << " processes x ";
+        std::cout << generator.numThreads() << " thread(s), " << actionKernel().name
+        << " kernel, " << params.potential.name() << " potential" << std::endl;
+        if (resume)
+            std::cout << "  resuming from " << options.resume << std::endl;
+    }
+
+    // Euclidean paths have pinned endpoints, so ground-state observables are
+    // measured on the middle half of each path, furthest from the ends.
+    GroundStateObservables observables(params.potential,
+                                       (uint64_t)params.numPaths * options.ensembles);
+    const int measureBegin = params.timeSteps / 4;
+    const int measureEnd = params.timeSteps - params.timeSteps / 4 + 1;
+
+    // Paths are generated and consumed a batch at a time and every statistic
+    // below is streaming, so memory is bounded by the batch, not --paths.
+    // Batches are whole generator chunks, which keeps the sampled paths the
+    // same whatever the batch size. Without --batch a distributed run gives
+    // each process one batch per ensemble.
+    const int chunk = PathGenerator::CHUNK_PATHS;
+    int batchSize = params.numPaths;
+    if (options.batch > 0 && options.batch < params.numPaths)
+        batchSize = (options.batch + chunk - 1) / chunk * chunk;
+    else if (options.batch <= 0 && group.size() > 1)
+        batchSize = ((params.numPaths + group.size() - 1) / group.size() + chunk - 1) /
+                    chunk * chunk;
+    SimulationParams batchParams = params;
+
+    // Every process takes the same contiguous run of batches from each
+    // ensemble, so together they cover exactly the paths of a single-process
+    // run with the same batches.
+    const int numBatches = (params.numPaths + batchSize - 1) / batchSize;
+    const int pathsBegin = (int)((int64_t)numBatches * group.rank() / group.size()) *
+                           batchSize;
+    const int pathsEnd = std::min<int64_t>(
+        params.numPaths,
+        (int64_t)numBatches * (group.rank() + 1) / group.size() * batchSize);
+
+    auto start = std::chrono::steady_clock::now();
+    auto lastReport = start;
+    auto lastCheckpoint = start;
+
+    EnsembleSums sums;
+
+    // Paths are a pure function of (seed, ensemble, path index), so resuming
+    // needs only the position in the run and the accumulators.
+    int firstEnsemble = 0, firstPath = 0;
+    if (resume) {
+        firstEnsemble = resume->get<int32_t>();
+        firstPath = resume->get<int32_t>();
+        sums.load(*resume);
+        observables.load(*resume);
+        if (!resume->ok()) {
+            std::cerr << "Cannot resume: " << resume->error() << std::endl;
+            return 1;
+        }
+    }
+
+    for (int e = firstEnsemble; e < options.ensembles; e++) {
+        int first = e == firstEnsemble ? std::max(firstPath, pathsBegin) : pathsBegin;
+        for (; first < pathsEnd; first += batchSize) {
+            batchParams.numPaths = std::min(batchSize, pathsEnd - first);
+            std::complex<double> sum =
+            generator.generate(paths, batchParams, e, first / chunk);
+
+            for (int i = 0; i < paths.numPaths(); i++) {
+                sums.actions.add(paths.actions()[i]);
+            }
+
+            if (params.euclidean) {
+                sums.addWeights(generator.logWeightScale(), sum.real());
+
+                // The generator normalized the weights to this batch's sum;
+                // undo that and put them on the observables' running scale,
+                // so every path keeps its weight whatever the batching.
+                const double factor =
+                sum.real() * observables.useLogScale(generator.logWeightScale());
+                observables.seek((uint64_t)e * params.numPaths + first);
+                for (int i = 0; i < paths.numPaths(); i++) {
+                    observables.add(paths.path(i), measureBegin, measureEnd,
+                                    factor * paths.amplitudesRe()[i]);
+                }
+            } else {
+                sums.amplitudes.add(sum);
+            }
+
+            if (pathsOut.is_open())
+                writePaths(pathsOut, e, first, paths);
+            const double logScale =
+            params.euclidean ? generator.logWeightScale() : 0.0;
+            if (archive.isOpen() &&
+                !archive.write(paths, e, first, sum, logScale)) {
+                std::cerr << "Cannot write " << options.binaryOut << ": "
+                << archive.error() << std::endl;
+                return 1;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (coordinator && now - lastReport > std::chrono::seconds(2)) {
+                lastReport = now;
+                std::cout << "  ensemble " << e << ": " << sums.actions.count()
+                << " paths";
+                if (group.size() > 1)
+                    std::cout << " on rank 0";
+                std::cout << ", <S> = " << sums.actions.mean() << " +/- "
+                << sums.actions.standardError();
+                if (params.euclidean) {
+                    Estimate x2 = observables.x2();
+                    std::cout << ", <x^2> = " << x2.mean << " +/- " << x2.error;
+                } else {
+                    std::cout << ", |sum| = " << std::abs(sums.amplitudes.value());
+                }
+                std::cout << std::endl;
+            }
+
+            if (checkpointDue(options, lastCheckpoint)) {
+                double seconds = priorSeconds + std::chrono::duration<double>(
+                    now - start)
+                .count();
+                CheckpointWriter out;
+                beginCheckpoint(out, options, seconds, summary, &pathsOut);
+                out.put<int32_t>(e);
+                out.put<int32_t>(first + paths.numPaths());
+                sums.save(out);
+                observables.save(out);
+                commitCheckpoint(out, options);
+            }
+        }
+
+        if (group.size() > 1 && !reduceEnsemble(group, sums, observables)) {
+            std::cerr << "Rank " << group.rank() << ": reduction failed: "
+            << group.error() << std::endl;
+            return 1;
+        }
+
+        if (coordinator) {
+            std::complex<double> sum =
+            params.euclidean ? std::complex<double>(sums.weightSum, 0.0)
+                             : sums.amplitudes.value();
+
+            summary << e << "," << params.numPaths << "," << params.timeSteps << ","
+            << sum.real() << "," << sum.imag() << "," << std::abs(sum) << ","
+            << sums.actions.mean() << "," << sums.actions.stddev() << ","
+            << sums.actions.min() << "," << sums.actions.max();
+
+            if (params.euclidean) {
+                Estimate x2 = observables.x2();
+                Estimate energy = observables.energy();
+                summary << "," << observables.effectiveSamples() << "," << x2.mean
+                << "," << x2.error << "," << energy.mean << "," << energy.error;
+            }
+            summary << "\n";
+        }
+
+        sums = EnsembleSums();
+    }
+
+    if (!archive.close()) {
+        std::cerr << "Cannot write " << options.binaryOut << ": "
+        << archive.error() << std::endl;
+        return 1;
+    }
+    if (!coordinator)
+        return 0;
+
+    double seconds = priorSeconds + std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start)
+    .count();
+    double totalPaths = (double)params.numPaths * options.ensembles;
+
+    if (params.euclidean) {
+        Estimate x2 = observables.x2();
+        Estimate energy = observables.energy();
+        std::cout << "  <x^2> = " << x2.mean << " +/- " << x2.error << ", E0 = "
+        << energy.mean << " +/- " << energy.error << " ("
+        << observables.effectiveSamples() << " effective samples)" << std::endl;
+        if (!options.histogramCsv.empty() &&
+            !writeHistogram(options.histogramCsv, observables))
+            return 1;
+    }
+
+    std::cout << "  " << totalPaths << " paths in " << seconds << " s ("
+    << totalPaths / seconds << " paths/s)" << std::endl;
+    std::cout << "  Results written to " << options.output << std::endl;
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    HeadlessOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    CheckpointReader checkpoint;
+    CheckpointReader *resume = nullptr;
+    double priorSeconds = 0.0;
+    uint64_t summaryBytes = 0, pathsBytes = 0;
+    if (!options.resume.empty()) {
+        if (!resumeOptions(options, checkpoint))
+            return 1;
+        resume = &checkpoint;
+        priorSeconds = checkpoint.get<double>();
+        summaryBytes = checkpoint.get<uint64_t>();
+        pathsBytes = checkpoint.get<uint64_t>();
+    }
+
+    ProcessGroup group;
+    bool started = options.workers > 1 ? group.startLocal(options.workers)
+                                       : group.startMpi(argc, argv);
+    if (!started) {
+        std::cerr << group.error() << std::endl;
+        return 1;
+    }
+    const bool coordinator = group.isCoordinator();
+    if (group.size() > 1) {
+        const char *conflict = nullptr;
+        if (options.sampler != "gaussian")
+            conflict = "--sampler other than gaussian";
+        else if (!options.checkpoint.empty() || resume)
+            conflict = "--checkpoint and --resume";
+        else if (!options.pathsCsv.empty() || !options.binaryOut.empty())
+            conflict = "--paths-csv and --binary-out";
+        if (conflict) {
+            if (coordinator)
+                std::cerr << "Distributed runs do not support " << conflict << std::endl;
+            return 1;
+        }
+    }
+
+    if (!options.simd.empty()) {
+        SimdLevel level;
+        if (!parseSimdLevel(options.simd.c_str(), level)) {
+            std::cerr << "Unknown SIMD level " << options.simd << std::endl;
+            return 1;
+        }
+        setSimdLevel(level);
+        if (resume && options.simd != actionKernel().name) {
+            std::cout << "  warning: checkpoint was written with the "
+            << options.simd << " kernel; continuing with " << actionKernel().name
+            << " may change the last bits of the results" << std::endl;
+        }
+    }
+
+    // Only rank 0 writes the summary.
+    std::ofstream summary;
+    if (resume) {
+        if (!reopenOutput(summary, options.output, summaryBytes))
+            return 1;
+    } else if (coordinator) {
+        summary.open(options.output.c_str());
+        if (!summary) {
+            std::cerr << "Cannot open " << options.output << std::endl;
+            return 1;
+        }
+    }
+    summary << std::setprecision(17);
+
+    if (options.sampler == "transfer") {
+        std::cout << "1D Quantum Path Integral Simulation - Headless" << std::endl;
+        return runTransferMatrix(options, summary);
+    }
+
+    if (options.continuum > 0) {
+        std::cout << "1D Quantum Path Integral Simulation - Headless" << std::endl;
+        return runContinuumLimit(options, summary);
+    }
+
+    int status;
+    if (options.sampler != "gaussian") {
+        std::cout << "1D Quantum Path Integral Simulation - Headless" << std::endl;
+        if (resume)
+            std::cout << "  resuming from " << options.resume << std::endl;
+        status = runMarkovChains(options, summary, resume, priorSeconds);
+    } else {
+        status = runGaussianEnsembles(options, summary, resume, priorSeconds,
+                                      pathsBytes, group);
+    }
+
+    if (!group.finish()) {
+        std::cerr << group.error() << std::endl;
+        status = 1;
+    }
+    if (status == 0 && !options.checkpoint.empty())
+        std::remove(options.checkpoint.c_str());
+    return status;
+}
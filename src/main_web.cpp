@@ -1,11 +1,17 @@
-#include <GLES2/gl2.h>
+#include <GLES3/gl3.h>
 #include <cmath>
 #include <complex>
+#include <cstddef>
 #include <iostream>
 #include <random>
 #include <string>
 #include <vector>
 
+#include "background_generator.h"
+#include "path_ensemble.h"
+#include "path_geometry.h"
+#include "profiler.h"
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #include <emscripten/html5.h>
@@ -40,141 +46,304 @@ void main() {
 }
 )";
 
-struct Path {
-    std::vector<double> positions;
-    std::complex<double> amplitude;
-    double action;
+// Paths are drawn from raw lattice data: one float x per vertex, the site
+// index from gl_VertexID and the path's packed colour from a texture filled
+// once per ensemble. Projection happens here instead of on the CPU.
+const char *pathVertexShaderSource = R"(#version 300 es
+in float a_x;
+
+uniform vec4 u_view;
+uniform vec2 u_time;
+uniform int u_numSites;
+uniform int u_colorWidth;
+uniform lowp sampler2D u_colors;
+
+out vec4 v_color;
+
+void main() {
+    int path = gl_VertexID / u_numSites;
+    int site = gl_VertexID - path * u_numSites;
+    float y = u_time.x + u_time.y * float(site);
+    gl_Position = vec4(a_x * u_view.x + u_view.y, y * u_view.z + u_view.w, 0.0, 1.0);
+
+    v_color = texelFetch(u_colors, ivec2(path % u_colorWidth, path / u_colorWidth), 0);
+}
+)";
+
+const char *pathFragmentShaderSource = R"(#version 300 es
+precision mediump float;
+in vec4 v_color;
+out vec4 fragColor;
+
+void main() {
+    fragColor = v_color;
+}
+)";
+
+struct Vertex {
+    float x, y;
+    GLubyte r, g, b, a;
 };
 
+// Static scene geometry is uploaded once; path geometry only when the
+// ensemble changes. Paths share one vertex per site and are drawn as indexed
+// GL_LINES, so interior sites are not duplicated per segment.
 class WebGLRenderer {
 private:
+    enum { COLOR_TEXTURE_WIDTH = 1024 };
+
     GLuint shaderProgram;
-    GLuint vertexBuffer;
-    GLuint colorBuffer;
+    GLuint pathProgram;
+    GLuint staticBuffer;
+    GLuint pathVertexBuffer;
+    GLuint pathIndexBuffer;
+    GLuint colorTexture;
     GLint positionAttrib;
     GLint colorAttrib;
+    GLint pathXAttrib;
+    GLint viewUniform, timeUniform, numSitesUniform, colorWidthUniform,
+    colorsUniform;
+
+    std::vector<Vertex> staticLines;
+    std::vector<Vertex> staticPoints;
+    GLsizei staticLineCount;
+    GLsizei staticPointCount;
+
+    std::vector<float> pathX;
+    AmplitudePalette palette;
+    std::vector<PathColor> colors;
+    std::vector<GLuint> pathIndices;
+    int indexedPaths, indexedSites;
+    size_t pathBufferSize;
+    float view[4];
+    float timeAxis[2];
+
+    static Vertex vertex(float x, float y, float r, float g, float b, float a) {
+        Vertex v;
+        v.x = x;
+        v.y = y;
+        v.r = (GLubyte)(r * 255.0f + 0.5f);
+        v.g = (GLubyte)(g * 255.0f + 0.5f);
+        v.b = (GLubyte)(b * 255.0f + 0.5f);
+        v.a = (GLubyte)(a * 255.0f + 0.5f);
+        return v;
+    }
 
-    std::vector<float> vertices;
-    std::vector<float> colors;
+    void bindVertices(GLuint buffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glVertexAttribPointer(positionAttrib, 2, GL_FLOAT, GL_FALSE,
+                              sizeof(Vertex), (const void *)offsetof(Vertex, x));
+        glVertexAttribPointer(colorAttrib, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                              sizeof(Vertex), (const void *)offsetof(Vertex, r));
+    }
 
 public:
-    bool init() {
-        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
-        GLuint fragmentShader =
-        compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
-
-        if (!vertexShader || !fragmentShader) {
-            return false;
-        }
+    WebGLRenderer()
+    : staticLineCount(0), staticPointCount(0), palette(15.0f, 0.1f, 0.8f),
+    indexedPaths(0), indexedSites(0), pathBufferSize(0) {}
 
-        shaderProgram = glCreateProgram();
-        glAttachShader(shaderProgram, vertexShader);
-        glAttachShader(shaderProgram, fragmentShader);
-        glLinkProgram(shaderProgram);
-
-        GLint success;
-        glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-        if (!success) {
-            char infoLog[512];
-            glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-            std::cout << "Shader program linking failed: " << infoLog << std::endl;
+    bool init() {
+        shaderProgram = linkProgram(vertexShaderSource, fragmentShaderSource);
+        pathProgram = linkProgram(pathVertexShaderSource, pathFragmentShaderSource);
+        if (!shaderProgram || !pathProgram) {
             return false;
         }
 
         positionAttrib = glGetAttribLocation(shaderProgram, "a_position");
         colorAttrib = glGetAttribLocation(shaderProgram, "a_color");
 
-        glGenBuffers(1, &vertexBuffer);
-        glGenBuffers(1, &colorBuffer);
+        pathXAttrib = glGetAttribLocation(pathProgram, "a_x");
+        viewUniform = glGetUniformLocation(pathProgram, "u_view");
+        timeUniform = glGetUniformLocation(pathProgram, "u_time");
+        numSitesUniform = glGetUniformLocation(pathProgram, "u_numSites");
+        colorWidthUniform = glGetUniformLocation(pathProgram, "u_colorWidth");
+        colorsUniform = glGetUniformLocation(pathProgram, "u_colors");
 
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+        glGenBuffers(1, &staticBuffer);
+        glGenBuffers(1, &pathVertexBuffer);
+        glGenBuffers(1, &pathIndexBuffer);
+
+        glGenTextures(1, &colorTexture);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
         return true;
     }
 
-    void beginRender() {
-        vertices.clear();
-        colors.clear();
-        glUseProgram(shaderProgram);
+    // World rectangle mapped onto the canvas.
+    void setView(float left, float right, float bottom, float top) {
+        view[0] = 2.0f / (right - left);
+        view[1] = -(right + left) / (right - left);
+        view[2] = 2.0f / (top - bottom);
+        view[3] = -(top + bottom) / (top - bottom);
+    }
+
+    // World y of the first and last time slice.
+    void setTimeAxis(float start, float end) {
+        timeAxis[0] = start;
+        timeAxis[1] = end;
     }
 
     void addLine(float x1, float y1, float x2, float y2, float r, float g,
                  float b, float a) {
-        vertices.push_back(x1);
-        vertices.push_back(y1);
-        vertices.push_back(x2);
-        vertices.push_back(y2);
-
-        colors.push_back(r);
-        colors.push_back(g);
-        colors.push_back(b);
-        colors.push_back(a);
-        colors.push_back(r);
-        colors.push_back(g);
-        colors.push_back(b);
-        colors.push_back(a);
-                 }
-
-                 void addPoint(float x, float y, float r, float g, float b, float a) {
-                     vertices.push_back(x);
-                     vertices.push_back(y);
-                     colors.push_back(r);
-                     colors.push_back(g);
-                     colors.push_back(b);
-                     colors.push_back(a);
-                 }
-
-                 void renderLines() {
-                     if (vertices.empty())
-                         return;
-
-                     glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-                     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float),
-                                  vertices.data(), GL_DYNAMIC_DRAW);
-                     glEnableVertexAttribArray(positionAttrib);
-                     glVertexAttribPointer(positionAttrib, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-                     glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
-                     glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(float), colors.data(),
-                                  GL_DYNAMIC_DRAW);
-                     glEnableVertexAttribArray(colorAttrib);
-                     glVertexAttribPointer(colorAttrib, 4, GL_FLOAT, GL_FALSE, 0, 0);
-
-                     glDrawArrays(GL_LINES, 0, vertices.size() / 2);
-
-                     vertices.clear();
-                     colors.clear();
-                 }
-
-                 void renderPoints() {
-                     if (vertices.empty())
-                         return;
-
-                     glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-                     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float),
-                                  vertices.data(), GL_DYNAMIC_DRAW);
-                     glEnableVertexAttribArray(positionAttrib);
-                     glVertexAttribPointer(positionAttrib, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-                     glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
-                     glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(float), colors.data(),
-                                  GL_DYNAMIC_DRAW);
-                     glEnableVertexAttribArray(colorAttrib);
-                     glVertexAttribPointer(colorAttrib, 4, GL_FLOAT, GL_FALSE, 0, 0);
-
-                     glDrawArrays(GL_POINTS, 0, vertices.size() / 2);
-
-                     vertices.clear();
-                     colors.clear();
-                 }
-
-                 void endRender() {
-                     glDisableVertexAttribArray(positionAttrib);
-                     glDisableVertexAttribArray(colorAttrib);
-                 }
+        staticLines.push_back(vertex(x1, y1, r, g, b, a));
+        staticLines.push_back(vertex(x2, y2, r, g, b, a));
+    }
+
+    void addPoint(float x, float y, float r, float g, float b, float a) {
+        staticPoints.push_back(vertex(x, y, r, g, b, a));
+    }
+
+    // Uploads everything added with addLine/addPoint since the last call.
+    void uploadStatic() {
+        staticLineCount = (GLsizei)staticLines.size();
+        staticPointCount = (GLsizei)staticPoints.size();
+
+        std::vector<Vertex> geometry(staticLines);
+        geometry.insert(geometry.end(), staticPoints.begin(), staticPoints.end());
+
+        glBindBuffer(GL_ARRAY_BUFFER, staticBuffer);
+        glBufferData(GL_ARRAY_BUFFER, geometry.size() * sizeof(Vertex),
+                     geometry.data(), GL_STATIC_DRAW);
+
+        staticLines.clear();
+        staticPoints.clear();
+    }
+
+    // Uploads x positions (one float per vertex) and one RGBA8 colour per
+    // path; everything else is derived in the path shader.
+    void uploadPaths(const PathEnsemble &paths, ThreadPool &pool) {
+        ScopedTimer timer("geometry");
+        const int numPaths = paths.numPaths();
+        const int numSites = paths.numSites();
+
+        if (numPaths != indexedPaths || numSites != indexedSites) {
+            pathIndices.clear();
+            pathIndices.reserve((size_t)numPaths * (numSites - 1) * 2);
+            for (int i = 0; i < numPaths; i++) {
+                GLuint base = (GLuint)i * numSites;
+                for (int t = 0; t + 1 < numSites; t++) {
+                    pathIndices.push_back(base + t);
+                    pathIndices.push_back(base + t + 1);
+                }
+            }
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pathIndexBuffer);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                         pathIndices.size() * sizeof(GLuint), pathIndices.data(),
+                         GL_STATIC_DRAW);
+            indexedPaths = numPaths;
+            indexedSites = numSites;
+        }
+
+        pathX.resize((size_t)numPaths * numSites);
+        for (int i = 0; i < numPaths; i++) {
+            const double *path = paths.path(i);
+            float *row = &pathX[(size_t)i * numSites];
+            for (int t = 0; t < numSites; t++) {
+                row[t] = (float)path[t];
+            }
+        }
+
+        size_t bytes = pathX.size() * sizeof(float);
+        glBindBuffer(GL_ARRAY_BUFFER, pathVertexBuffer);
+        if (bytes > pathBufferSize) {
+            glBufferData(GL_ARRAY_BUFFER, bytes, pathX.data(), GL_DYNAMIC_DRAW);
+            pathBufferSize = bytes;
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, pathX.data());
+        }
+
+        // Rows of COLOR_TEXTURE_WIDTH texels stand in for a 1D texture,
+        // which WebGL does not have.
+        int width = numPaths < COLOR_TEXTURE_WIDTH ? numPaths
+                                                   : COLOR_TEXTURE_WIDTH;
+        int height = (numPaths + width - 1) / width;
+        colors.resize((size_t)width * height);
+        palette.colorEnsemble(paths, pool, colors.data());
+
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, colors.data());
+    }
+
+    void render() {
+        ScopedTimer timer("draw");
+        glUseProgram(shaderProgram);
+        glEnableVertexAttribArray(positionAttrib);
+        glEnableVertexAttribArray(colorAttrib);
+
+        bindVertices(staticBuffer);
+        glDrawArrays(GL_LINES, 0, staticLineCount);
+
+        glDisableVertexAttribArray(positionAttrib);
+        glDisableVertexAttribArray(colorAttrib);
+
+        if (!pathIndices.empty()) {
+            glUseProgram(pathProgram);
+            glUniform4fv(viewUniform, 1, view);
+            glUniform2f(timeUniform, timeAxis[0],
+                        (timeAxis[1] - timeAxis[0]) / (indexedSites - 1));
+            glUniform1i(numSitesUniform, indexedSites);
+            glUniform1i(colorWidthUniform,
+                        indexedPaths < COLOR_TEXTURE_WIDTH
+                        ? indexedPaths
+                        : COLOR_TEXTURE_WIDTH);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, colorTexture);
+            glUniform1i(colorsUniform, 0);
+
+            glEnableVertexAttribArray(pathXAttrib);
+            glBindBuffer(GL_ARRAY_BUFFER, pathVertexBuffer);
+            glVertexAttribPointer(pathXAttrib, 1, GL_FLOAT, GL_FALSE, 0, 0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pathIndexBuffer);
+            glDrawElements(GL_LINES, (GLsizei)pathIndices.size(),
+                           GL_UNSIGNED_INT, 0);
+            glDisableVertexAttribArray(pathXAttrib);
+        }
+
+        glUseProgram(shaderProgram);
+        glEnableVertexAttribArray(positionAttrib);
+        glEnableVertexAttribArray(colorAttrib);
+        bindVertices(staticBuffer);
+        glDrawArrays(GL_POINTS, staticLineCount, staticPointCount);
+
+        glDisableVertexAttribArray(positionAttrib);
+        glDisableVertexAttribArray(colorAttrib);
+    }
 
 private:
+    GLuint linkProgram(const char *vertexSource, const char *fragmentSource) {
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+
+        if (!vertexShader || !fragmentShader) {
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glLinkProgram(program);
+
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cout << "Shader program linking failed: " << infoLog << std::endl;
+            return 0;
+        }
+
+        return program;
+    }
+
     GLuint compileShader(GLenum type, const char *source) {
         GLuint shader = glCreateShader(type);
         glShaderSource(shader, 1, &source, NULL);
@@ -195,39 +364,35 @@ private:
 
 class PathIntegralSimulation {
 private:
-    std::vector<Path> paths;
-    std::mt19937 rng;
-    std::normal_distribution<double> gaussian;
+    PathEnsemble paths;
+    BackgroundGenerator generator;
+    ThreadPool colorPool;
+    uint64_t generation;
     int currentFrame;
     double totalTime;
     int canvasWidth, canvasHeight;
     WebGLRenderer renderer;
-
-    double V(double x) { return 0.5 * x * x; }
-
-    double calculateAction(const std::vector<double> &positions) {
-        double action = 0.0;
-        for (int t = 1; t < positions.size(); t++) {
-            double dx = positions[t] - positions[t - 1];
-            double kinetic = 0.5 * MASS * dx * dx / (DT * DT);
-            double potential = V(positions[t]);
-            action += (kinetic - potential) * DT;
-        }
-        return action;
-    }
-
-    std::vector<double> generateRandomPath(double x0, double xf) {
-        std::vector<double> path(TIME_STEPS + 1);
-        path[0] = x0;
-        path[TIME_STEPS] = xf;
-
-        for (int t = 1; t < TIME_STEPS; t++) {
-            double alpha = (double)t / TIME_STEPS;
-            path[t] = (1 - alpha) * x0 + alpha * xf;
-            path[t] += gaussian(rng) * 0.5;
-        }
-
-        return path;
+    bool pathsDirty;
+    bool showProfiler;
+    bool euclidean;
+
+    Potential potential;
+
+    double V(double x) const { return potential.value(x); }
+
+    SimulationParams params() const {
+        SimulationParams p;
+        p.numPaths = NUM_PATHS;
+        p.timeSteps = TIME_STEPS;
+        p.hbar = HBAR;
+        p.mass = MASS;
+        p.dt = DT;
+        p.x0 = -2.0;
+        p.xf = 2.0;
+        p.seed = 42;
+        p.potential = potential;
+        p.euclidean = euclidean;
+        return p;
     }
 
     void worldToScreen(double wx, double wy, float &sx, float &sy) {
@@ -237,39 +402,33 @@ private:
 
 public:
     PathIntegralSimulation()
-    : rng(42), gaussian(0.0, 1.0), currentFrame(0), totalTime(0.0),
-    canvasWidth(800), canvasHeight(600) {
+    : generation(0), currentFrame(0), totalTime(0.0),
+    canvasWidth(800), canvasHeight(600), pathsDirty(true), showProfiler(false),
+    euclidean(false) {
         generatePaths();
+        generator.wait();
+        collectPaths();
     }
 
-    bool init() { return renderer.init(); }
+    bool init() {
+        if (!renderer.init())
+            return false;
+        renderer.setView(-5, 5, -3, 3);
+        renderer.setTimeAxis(-2.5, 2.5);
+        buildStaticGeometry();
+        return true;
+    }
 
+    // Runs on the generator's worker when the build has pthreads and inline
+    // otherwise; either way the result is picked up by collectPaths().
     void generatePaths() {
-        paths.clear();
-        double x0 = -2.0;
-        double xf = 2.0;
-
-        for (int i = 0; i < NUM_PATHS; i++) {
-            Path path;
-            path.positions = generateRandomPath(x0, xf);
-            path.action = calculateAction(path.positions);
-
-            std::complex<double> phase(0, -path.action / HBAR);
-            path.amplitude = std::exp(phase);
-
-            paths.push_back(path);
-        }
-
-        std::complex<double> sum(0, 0);
-        for (const auto &path : paths) {
-            sum += path.amplitude;
-        }
+        generator.request(params(), generation++);
+    }
 
-        if (std::abs(sum) > 1e-10) {
-            for (auto &path : paths) {
-                path.amplitude /= sum;
-            }
-        }
+    void collectPaths() {
+        std::complex<double> sum;
+        if (generator.collect(paths, sum))
+            pathsDirty = true;
     }
 
     void update() {
@@ -279,6 +438,7 @@ public:
         if (currentFrame % 180 == 0) {
             generatePaths();
         }
+        collectPaths();
     }
 
     void setCanvasSize(int width, int height) {
@@ -287,14 +447,7 @@ public:
         glViewport(0, 0, width, height);
     }
 
-    void render() {
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        renderer.beginRender();
-
+    void buildStaticGeometry() {
         float sx1, sy1, sx2, sy2;
 
         worldToScreen(-5, 0, sx1, sy1);
@@ -316,8 +469,6 @@ public:
             renderer.addLine(sx1, sy1, sx2, sy2, 0.1f, 0.1f, 0.1f, 0.5f);
         }
 
-        renderer.renderLines();
-
         for (int i = -39; i <= 39; i++) {
             double x1 = i * 0.1;
             double x2 = (i + 1) * 0.1;
@@ -333,54 +484,85 @@ public:
             renderer.addLine(sx1, sy1, sx2, sy2, 0.3f, 0.3f, 1.0f, 0.8f);
         }
 
-        renderer.renderLines();
+        float startX, startY, endX, endY;
+        worldToScreen(-2.0, -2.5, startX, startY);
+        worldToScreen(2.0, 2.5, endX, endY);
 
-        for (size_t i = 0; i < paths.size(); i++) {
-            const Path &path = paths[i];
+        renderer.addPoint(startX, startY, 1.0f, 0.2f, 0.2f, 1.0f);
+        renderer.addPoint(endX, endY, 1.0f, 0.2f, 0.2f, 1.0f);
 
-            double magnitude = std::abs(path.amplitude);
-            double phase = std::arg(path.amplitude);
+        renderer.uploadStatic();
+    }
 
-            float r = (float)(0.5 + 0.5 * cos(phase));
-            float g = (float)(0.5 + 0.5 * cos(phase + 2 * M_PI / 3));
-            float b = (float)(0.5 + 0.5 * cos(phase + 4 * M_PI / 3));
+    void buildPathGeometry() {
+        renderer.uploadPaths(paths, colorPool);
+        pathsDirty = false;
+    }
 
-            float alpha = (float)(magnitude * 15);
-            if (alpha > 1.0f)
-                alpha = 1.0f;
-            if (alpha < 0.1f)
-                alpha = 0.1f;
+    void render() {
+        Profiler &profiler = Profiler::instance();
+        profiler.endFrame();
+        profiler.beginFrame();
 
-            r *= alpha;
-            g *= alpha;
-            b *= alpha;
-            alpha *= 0.8f;
+        glClear(GL_COLOR_BUFFER_BIT);
 
-            for (int t = 0; t < (int)path.positions.size() - 1; t++) {
-                double wx1 = path.positions[t];
-                double wy1 = -2.5 + 5.0 * t / (path.positions.size() - 1);
-                double wx2 = path.positions[t + 1];
-                double wy2 = -2.5 + 5.0 * (t + 1) / (path.positions.size() - 1);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-                float sx1, sy1, sx2, sy2;
-                worldToScreen(wx1, wy1, sx1, sy1);
-                worldToScreen(wx2, wy2, sx2, sy2);
-                renderer.addLine(sx1, sy1, sx2, sy2, r, g, b, alpha);
-            }
-        }
+        if (pathsDirty)
+            buildPathGeometry();
 
-        renderer.renderLines();
+        renderer.render();
 
-        float startX, startY, endX, endY;
-        worldToScreen(-2.0, -2.5, startX, startY);
-        worldToScreen(2.0, 2.5, endX, endY);
+        if (showProfiler && currentFrame % 15 == 0)
+            showOverlay(profiler.summary(paths.numPaths()));
+    }
 
-        renderer.addPoint(startX, startY, 1.0f, 0.2f, 0.2f, 1.0f);
-        renderer.addPoint(endX, endY, 1.0f, 0.2f, 0.2f, 1.0f);
+    // The overlay is a <pre> laid over the canvas rather than GL text.
+    void showOverlay(const std::string &text) {
+#ifdef __EMSCRIPTEN__
+        EM_ASM({
+            var overlay = document.getElementById('profiler-overlay');
+            if (!overlay) {
+                overlay = document.createElement('pre');
+                overlay.id = 'profiler-overlay';
+                overlay.style.cssText = 'position:fixed;top:8px;right:8px;' +
+                'margin:0;padding:6px;font:11px monospace;color:#fff;' +
+                'background:rgba(0,0,0,0.6);pointer-events:none;z-index:10';
+                document.body.appendChild(overlay);
+            }
+            overlay.textContent = UTF8ToString($0);
+            overlay.style.display = $1 ? 'block' : 'none';
+        }, text.c_str(), showProfiler);
+#endif
+    }
 
-        renderer.renderPoints();
+    void setProfilerOverlay(bool enabled) {
+        showProfiler = enabled;
+        Profiler::instance().setEnabled(enabled);
+        showOverlay(enabled ? Profiler::instance().summary(paths.numPaths())
+                            : std::string());
+    }
 
-        renderer.endRender();
+    // Starts a trace, or stops it and offers the JSON as a download.
+    void toggleTrace() {
+        Profiler &profiler = Profiler::instance();
+        if (!profiler.isTracing()) {
+            profiler.startTrace();
+            return;
+        }
+        profiler.stopTrace();
+#ifdef __EMSCRIPTEN__
+        std::string json = profiler.traceJson();
+        EM_ASM({
+            var blob = new Blob([UTF8ToString($0)], {type: 'application/json'});
+            var link = document.createElement('a');
+            link.href = URL.createObjectURL(blob);
+            link.download = 'path_integral_trace.json';
+            link.click();
+            URL.revokeObjectURL(link.href);
+        }, json.c_str());
+#endif
     }
 
     void keyPressed(int key) {
@@ -389,6 +571,18 @@ public:
             case 114:
                 generatePaths();
                 break;
+            case 80:
+            case 112:
+                setProfilerOverlay(!showProfiler);
+                break;
+            case 84:
+            case 116:
+                toggleTrace();
+                break;
+            case 69:
+            case 101:
+                setEuclidean(!euclidean);
+                break;
         }
     }
 
@@ -442,6 +636,21 @@ public:
             generatePaths();
         }
     }
+
+    // Redraws the potential curve along with the rest of the static geometry.
+    void setPotential(const Potential &V) {
+        potential = V;
+        buildStaticGeometry();
+        generatePaths();
+    }
+
+    const Potential &getPotential() const { return potential; }
+
+    // Positive weights exp(-S_E/hbar) instead of phases.
+    void setEuclidean(bool enabled) {
+        euclidean = enabled;
+        generatePaths();
+    }
 };
 
 PathIntegralSimulation *sim = nullptr;
@@ -521,6 +730,46 @@ EM_BOOL keydown_callback(int eventType, const EmscriptenKeyboardEvent *keyEvent,
                                                                                 if (sim)
                                                                                     sim->generatePaths();
                                                                             }
+
+                                                                            void setPotential(int kind) {
+                                                                                if (sim && kind >= POTENTIAL_HARMONIC && kind < POTENTIAL_TABULATED)
+                                                                                    sim->setPotential(Potential::withDefaults((PotentialKind)kind));
+                                                                            }
+
+                                                                            void setPotentialParams(double a, double b, double c) {
+                                                                                if (sim && sim->getPotential().kind != POTENTIAL_TABULATED) {
+                                                                                    Potential potential = sim->getPotential();
+                                                                                    potential.a = a;
+                                                                                    potential.b = b;
+                                                                                    potential.c = c;
+                                                                                    sim->setPotential(potential);
+                                                                                }
+                                                                            }
+
+                                                                            // xs and vs point at count doubles each in the wasm heap (Module._malloc).
+                                                                            int setPotentialTable(const double *xs, const double *vs, int count) {
+                                                                                std::shared_ptr<PotentialTable> table(new PotentialTable());
+                                                                                if (!sim || !table->build(std::vector<double>(xs, xs + count),
+                                                                                                          std::vector<double>(vs, vs + count)))
+                                                                                    return 0;
+                                                                                sim->setPotential(Potential::tabulated(table));
+                                                                                return 1;
+                                                                            }
+
+                                                                            void setEuclidean(int enabled) {
+                                                                                if (sim)
+                                                                                    sim->setEuclidean(enabled != 0);
+                                                                            }
+
+                                                                            void setProfilerOverlay(int enabled) {
+                                                                                if (sim)
+                                                                                    sim->setProfilerOverlay(enabled != 0);
+                                                                            }
+
+                                                                            void toggleTrace() {
+                                                                                if (sim)
+                                                                                    sim->toggleTrace();
+                                                                            }
                                                                         }
 
                                                                         int main(int argc, char **argv) {
@@ -0,0 +1,452 @@
+#include "metropolis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "action_kernel.h"
+#include "checkpoint.h"
+
+static const double PI = 3.14159265358979323846;
+
+MetropolisSampler::MetropolisSampler(const SimulationParams &params,
+                                     bool periodic, uint64_t stream)
+: params(params), periodic(periodic),
+sites(periodic ? params.timeSteps : params.timeSteps + 1), method(METROPOLIS),
+stepSize(2.0 * std::sqrt(params.hbar * params.dt / (2.0 * params.mass))),
+uniform(0.0, 1.0),
+gaussian(0.0, 1.0), leapfrogSteps(10), leapfrogStep(0.0), fourierMass(1.0),
+massReady(false), massStiffness(0.0), massDiagonal(0.0), massCornerScale(0.0),
+attempts(0), accepted(0) {
+    std::seed_seq seq{(uint32_t)params.seed, (uint32_t)(params.seed >> 32),
+                      (uint32_t)stream, (uint32_t)(stream >> 32)};
+    rng.seed(seq);
+    x.resize(sites);
+    reset();
+
+    int l = (int)std::lround(std::log2(1.0 / params.dt));
+    setLevels(l);
+}
+
+void MetropolisSampler::setLevels(int l) {
+    // A segment needs at least one free site and must fit inside the lattice
+    // with its two end sites held fixed.
+    levels = 1;
+    while (levels < l && (2 << levels) <= sites - 1) {
+        levels++;
+    }
+}
+
+void MetropolisSampler::reset() {
+    for (int t = 0; t < sites; t++) {
+        if (periodic) {
+            x[t] = 0.0;
+        } else {
+            double alpha = (double)t / params.timeSteps;
+            x[t] = (1 - alpha) * params.x0 + alpha * params.xf;
+        }
+    }
+    lattice.bind(x.data(), sites, periodic, 0.5 * params.mass / params.dt,
+                 params.dt, params.potential);
+    attempts = 0;
+    accepted = 0;
+}
+
+bool MetropolisSampler::prolongFrom(const MetropolisSampler &coarse) {
+    const int links = periodic ? sites : sites - 1;
+    const int coarseLinks = coarse.periodic ? coarse.sites : coarse.sites - 1;
+    if (coarse.periodic != periodic || links != 2 * coarseLinks)
+        return false;
+
+    const double width = std::sqrt(params.hbar * params.dt / (2.0 * params.mass));
+    for (int t = 0; t < sites; t += 2) {
+        x[t] = coarse.x[t / 2];
+    }
+    for (int t = 1; t < sites; t += 2) {
+        double right = t + 1 < sites ? x[t + 1] : x[0];
+        x[t] = 0.5 * (x[t - 1] + right) + width * gaussian(rng);
+    }
+    lattice.recompute();
+    return true;
+}
+
+void MetropolisSampler::updateSite(int t) {
+    const double old = x[t];
+
+    double proposal;
+    double deltaS;
+    if (method == HEAT_BATH) {
+        // Draw from the exact Gaussian conditional of the kinetic term and
+        // correct for the potential with a Metropolis step.
+        int l = t == 0 ? sites - 1 : t - 1;
+        int r = t + 1 == sites ? 0 : t + 1;
+        double width = std::sqrt(params.hbar * params.dt / (2.0 * params.mass));
+        proposal = 0.5 * (x[l] + x[r]) + width * gaussian(rng);
+        deltaS = lattice.deltaPotential(t, proposal);
+    } else {
+        proposal = old + stepSize * (2.0 * uniform(rng) - 1.0);
+        deltaS = lattice.deltaAction(t, proposal);
+    }
+
+    attempts++;
+    if (deltaS <= 0.0 || uniform(rng) < std::exp(-deltaS / params.hbar)) {
+        lattice.set(t, proposal);
+        accepted++;
+    }
+}
+
+int MetropolisSampler::segmentSite(int start, int k) const {
+    int t = start + k;
+    return t >= sites ? t - sites : t;
+}
+
+// Multilevel Metropolis (Ceperley, Rev. Mod. Phys. 67, 279, sec. V.F). The
+// segment's midpoints are drawn level by level from the exact free-particle
+// bridge between their already placed neighbours, so the kinetic term never
+// enters an acceptance test. Level l checks the potential sampled at spacing
+// 2^(l-1) against the previous, coarser estimate, and most bad proposals die
+// at the coarse levels before the fine ones are even drawn. The finest level
+// is the exact potential action, which keeps detailed balance. Midpoints go
+// straight into the lattice inside a batch, which a rejection rolls back.
+void MetropolisSampler::bisectionMove() {
+    const int span = 1 << levels;
+    int start;
+    if (periodic) {
+        start = std::min((int)(uniform(rng) * sites), sites - 1);
+    } else {
+        int starts = sites - span;
+        start = std::min((int)(uniform(rng) * starts), starts - 1);
+    }
+
+    trialPotential.resize(span + 1);
+
+    attempts++;
+    lattice.beginBatch();
+    double coarser = 0.0;
+    for (int l = levels; l >= 1; l--) {
+        const int half = 1 << (l - 1);
+        const double width =
+        std::sqrt(params.hbar * half * params.dt / (2.0 * params.mass));
+        for (int k = half; k < span; k += 2 * half) {
+            const int site = segmentSite(start, k);
+            double value = 0.5 * (x[segmentSite(start, k - half)] +
+                                  x[segmentSite(start, k + half)]) +
+                           width * gaussian(rng);
+            trialPotential[k] = lattice.deltaPotential(site, value);
+            lattice.set(site, value);
+        }
+
+        double estimate = 0.0;
+        for (int k = half; k < span; k += half) {
+            estimate += trialPotential[k];
+        }
+        estimate *= half;
+
+        double deltaS = estimate - coarser;
+        if (deltaS > 0.0 && uniform(rng) >= std::exp(-deltaS / params.hbar)) {
+            lattice.rollback();
+            return;
+        }
+        coarser = estimate;
+    }
+
+    lattice.commit();
+    accepted++;
+}
+
+void MetropolisSampler::setTrajectory(int steps, double step,
+                                      double mass) {
+    leapfrogSteps = std::max(1, steps);
+    leapfrogStep = step;
+    fourierMass = std::max(0.0, mass);
+    massReady = false;
+}
+
+// By default an accelerated trajectory lasts a quarter period of the modes
+// of an oscillator matching the mass term, which all have frequency 1. With
+// unit masses the stiffest mode has frequency about 2 sqrt(m / (dt hbar)) and
+// is kept to half a radian per step.
+double MetropolisSampler::getLeapfrogStep() const {
+    if (leapfrogStep > 0)
+        return leapfrogStep;
+    if (fourierMass > 0)
+        return 0.5 * PI / leapfrogSteps;
+    return 0.25 * std::sqrt(params.dt * params.hbar / params.mass);
+}
+
+// Forward and back substitution for the constant tridiagonal matrix whose
+// pivots and upper factors were computed by prepareMass.
+static void tridiagonalSolve(const std::vector<double> &pivot,
+                             const std::vector<double> &upper, double off,
+                             const double *rhs, double *out) {
+    const int n = (int)pivot.size();
+    out[0] = rhs[0] * pivot[0];
+    for (int i = 1; i < n; i++) {
+        out[i] = (rhs[i] - off * out[i - 1]) * pivot[i];
+    }
+    for (int i = n - 2; i >= 0; i--) {
+        out[i] -= upper[i] * out[i + 1];
+    }
+}
+
+void MetropolisSampler::prepareMass() {
+    momentum.resize(sites);
+    velocity.resize(sites);
+    gradient.resize(sites);
+    saved.resize(sites);
+    for (int t = 0; t < sites; t++) {
+        momentum[t] = 0.0;
+        velocity[t] = 0.0;
+        gradient[t] = 0.0;
+    }
+    massReady = true;
+    if (fourierMass <= 0)
+        return;
+
+    // M = (m / (dt hbar)) L + dt c / hbar on the free sites, L the lattice
+    // Laplacian: the Hessian of S_E / hbar for V'' = c.
+    const int n = periodic ? sites : sites - 2;
+    massStiffness = params.mass / (params.dt * params.hbar);
+    massDiagonal = 2.0 * massStiffness + params.dt * fourierMass / params.hbar;
+    const double off = -massStiffness;
+
+    // The periodic corners are split off as a rank-one term,
+    // A = T + u v^T with u = (gamma, 0, ..., off) and v = (1, 0, ..., off / gamma)
+    // (Numerical Recipes, cyclic tridiagonal systems).
+    const double gamma = -massDiagonal;
+    std::vector<double> diagonal(n, massDiagonal);
+    if (periodic) {
+        diagonal[0] -= gamma;
+        diagonal[n - 1] -= off * off / gamma;
+    }
+
+    massPivot.resize(n);
+    massUpper.resize(n);
+    massPivot[0] = 1.0 / diagonal[0];
+    massUpper[0] = off * massPivot[0];
+    for (int i = 1; i < n; i++) {
+        massPivot[i] = 1.0 / (diagonal[i] - off * massUpper[i - 1]);
+        massUpper[i] = off * massPivot[i];
+    }
+
+    massCorner.clear();
+    if (periodic) {
+        std::vector<double> u(n, 0.0);
+        u[0] = gamma;
+        u[n - 1] += off;
+        massCorner.resize(n);
+        tridiagonalSolve(massPivot, massUpper, off, u.data(), massCorner.data());
+        massCornerScale =
+        1.0 / (1.0 + massCorner[0] + off * massCorner[n - 1] / gamma);
+    }
+}
+
+void MetropolisSampler::solveMass(const double *rhs, double *out) const {
+    const double off = -massStiffness;
+    tridiagonalSolve(massPivot, massUpper, off, rhs, out);
+    if (periodic) {
+        const int n = (int)massPivot.size();
+        const double f =
+        (out[0] + off * out[n - 1] / -massDiagonal) * massCornerScale;
+        for (int i = 0; i < n; i++) {
+            out[i] -= f * massCorner[i];
+        }
+    }
+}
+
+void MetropolisSampler::actionGradient(double *g) const {
+    const ActionCoefficients c =
+    makeEuclideanCoefficients(params.mass, params.dt);
+    actionKernel().actionGradient(x.data(), 1, sites - 1, c, params.potential, g);
+    if (periodic) {
+        // The kernel reads both neighbours in place; the end sites wrap.
+        const int ends[2] = {0, sites - 1};
+        for (int i = 0; i < 2; i++) {
+            int t = ends[i];
+            int l = t == 0 ? sites - 1 : t - 1;
+            int r = t + 1 == sites ? 0 : t + 1;
+            g[t] = params.mass / params.dt * (2.0 * x[t] - x[l] - x[r]) +
+                   params.dt * params.potential.derivative(x[t]);
+        }
+    }
+}
+
+// Hybrid Monte Carlo (Duane, Kennedy, Pendleton and Roweth, Phys. Lett. B
+// 195, 216). Leapfrog is reversible and preserves phase-space volume, so
+// accepting on exp(-dH) keeps detailed balance; its O(eps^2) error in H only
+// costs acceptance. The action is recomputed from scratch at the end rather
+// than updated site by site.
+void MetropolisSampler::hybridMove() {
+    if (!massReady)
+        prepareMass();
+
+    const int first = periodic ? 0 : 1;
+    const int n = periodic ? sites : sites - 2;
+    const double eps = getLeapfrogStep();
+    const double kick = eps / params.hbar;
+    const bool accelerated = fourierMass > 0;
+    double *q = x.data() + first;
+    double *p = momentum.data() + first;
+    double *g = gradient.data() + first;
+    double *v = accelerated ? velocity.data() + first : p;
+
+    if (accelerated) {
+        // p = sqrt(m / (dt hbar)) D^T z + sqrt(dt c / hbar) w has covariance
+        // M, with D the link differences, z one deviate per link (link t
+        // joins sites t and t + 1) and w one per site.
+        double *z = velocity.data();
+        const int links = periodic ? sites : sites - 1;
+        for (int t = 0; t < links; t++) {
+            z[t] = gaussian(rng);
+        }
+        const double link = std::sqrt(massStiffness);
+        const double site = std::sqrt(params.dt * fourierMass / params.hbar);
+        for (int i = 0; i < n; i++) {
+            int t = first + i;
+            int left = t == 0 ? sites - 1 : t - 1;
+            p[i] = link * (z[left] - z[t]) + site * gaussian(rng);
+        }
+        solveMass(p, v);
+    } else {
+        for (int i = 0; i < n; i++) {
+            p[i] = gaussian(rng);
+        }
+    }
+
+    double kinetic = 0.0;
+    for (int i = 0; i < n; i++) {
+        kinetic += p[i] * v[i];
+        saved[i] = q[i];
+    }
+    const double start = lattice.action() / params.hbar + 0.5 * kinetic;
+
+    actionGradient(gradient.data());
+    for (int i = 0; i < n; i++) {
+        p[i] -= 0.5 * kick * g[i];
+    }
+    for (int s = 0; s < leapfrogSteps; s++) {
+        if (accelerated)
+            solveMass(p, v);
+        for (int i = 0; i < n; i++) {
+            q[i] += eps * v[i];
+        }
+        actionGradient(gradient.data());
+        const double h = s + 1 < leapfrogSteps ? kick : 0.5 * kick;
+        for (int i = 0; i < n; i++) {
+            p[i] -= h * g[i];
+        }
+    }
+
+    if (accelerated)
+        solveMass(p, v);
+    kinetic = 0.0;
+    for (int i = 0; i < n; i++) {
+        kinetic += p[i] * v[i];
+    }
+    lattice.recompute();
+    const double deltaH =
+    lattice.action() / params.hbar + 0.5 * kinetic - start;
+
+    attempts++;
+    if (deltaH <= 0.0 || uniform(rng) < std::exp(-deltaH)) {
+        accepted++;
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        q[i] = saved[i];
+    }
+    lattice.recompute();
+}
+
+void MetropolisSampler::sweep() {
+    if (method == HYBRID) {
+        hybridMove();
+    } else if (method == BISECTION) {
+        const int span = 1 << levels;
+        const int free = periodic ? sites : sites - 2;
+        const int moves = std::max(1, free / (span - 1));
+        for (int i = 0; i < moves; i++) {
+            bisectionMove();
+        }
+    } else if (periodic) {
+        for (int t = 0; t < sites; t++) {
+            updateSite(t);
+        }
+    } else {
+        for (int t = 1; t < sites - 1; t++) {
+            updateSite(t);
+        }
+    }
+}
+
+double MetropolisSampler::meanX2() const {
+    double sum = 0.0;
+    for (int t = 0; t < sites; t++) {
+        sum += x[t] * x[t];
+    }
+    return sum / sites;
+}
+
+double MetropolisSampler::virialEnergy() const {
+    double sum = 0.0;
+    for (int t = 0; t < sites; t++) {
+        sum += params.potential.value(x[t]) +
+               0.5 * x[t] * params.potential.derivative(x[t]);
+    }
+    return sum / sites;
+}
+
+void MetropolisSampler::copyTo(PathEnsemble &paths, int row) const {
+    double *out = paths.path(row);
+    for (int t = 0; t < sites; t++) {
+        out[t] = x[t];
+    }
+    if (periodic)
+        out[sites] = x[0];
+}
+
+void MetropolisSampler::save(CheckpointWriter &out) const {
+    // The standard streams for engines and distributions round-trip exactly,
+    // including a normal distribution's cached second deviate.
+    std::ostringstream generator;
+    generator << rng << " " << uniform << " " << gaussian;
+    out.putString(generator.str());
+
+    out.put<uint32_t>((uint32_t)method);
+    out.put<double>(stepSize);
+    out.put<int32_t>(levels);
+    out.put<int32_t>(leapfrogSteps);
+    out.put<double>(leapfrogStep);
+    out.put<double>(fourierMass);
+    out.put<uint64_t>(attempts);
+    out.put<uint64_t>(accepted);
+    out.put<int32_t>(sites);
+    for (int t = 0; t < sites; t++) {
+        out.put<double>(x[t]);
+    }
+    out.put<double>(lattice.action());
+}
+
+bool MetropolisSampler::load(CheckpointReader &in) {
+    std::istringstream generator(in.getString());
+    generator >> rng >> uniform >> gaussian;
+
+    method = (UpdateMethod)in.get<uint32_t>();
+    stepSize = in.get<double>();
+    levels = in.get<int32_t>();
+    leapfrogSteps = in.get<int32_t>();
+    leapfrogStep = in.get<double>();
+    fourierMass = in.get<double>();
+    massReady = false;
+    attempts = in.get<uint64_t>();
+    accepted = in.get<uint64_t>();
+    if (in.get<int32_t>() != sites || !generator)
+        return false;
+    for (int t = 0; t < sites; t++) {
+        x[t] = in.get<double>();
+    }
+    lattice.bind(x.data(), sites, periodic, 0.5 * params.mass / params.dt,
+                 params.dt, params.potential);
+    lattice.restoreTotal(in.get<double>());
+    return in.ok();
+}
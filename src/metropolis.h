@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "path_ensemble.h"
+#include "path_state.h"
+#include "simulation_params.h"
+
+class CheckpointReader;
+class CheckpointWriter;
+
+// Markov-chain sampler over the imaginary-time lattice action
+//   S_E = sum_t [ m/(2 dt) (x_{t+1} - x_t)^2 + dt V(x_t) ].
+// With periodic boundaries the lattice has timeSteps sites (x_N == x_0) and
+// samples |psi_0|^2 once T = timeSteps * dt is large; otherwise the endpoints
+// are pinned to x0/xf and only interior sites are updated.
+//
+// HYBRID is Hybrid Monte Carlo: the whole path moves at once along a
+// leapfrog trajectory of H = S_E/hbar + p^T M^-1 p / 2 under Gaussian
+// fictitious momenta, and the end point is accepted on the change in H.
+// With Fourier acceleration the mass matrix M is the free lattice action
+// plus a curvature term, (m/dt) L + dt c, whose Fourier modes are exactly the
+// lattice's; every mode of an oscillator with V'' = c then moves at the same
+// frequency, so long-wavelength modes no longer need O(N^2) updates. M is
+// tridiagonal (cyclic for periodic paths), so p ~ N(0, M) and M^-1 p cost
+// O(N) without a transform.
+class MetropolisSampler {
+public:
+    enum UpdateMethod { METROPOLIS, HEAT_BATH, BISECTION, HYBRID };
+
+    MetropolisSampler(const SimulationParams &params, bool periodic,
+                      uint64_t stream = 0);
+
+    void setMethod(UpdateMethod m) { method = m; }
+    UpdateMethod updateMethod() const { return method; }
+
+    // Half-width of the uniform Metropolis proposal.
+    void setStepSize(double step) { stepSize = step; }
+    double getStepSize() const { return stepSize; }
+
+    // Bisection moves regenerate 2^levels links at a time. The default spans
+    // about one unit of imaginary time, clamped to the lattice.
+    void setLevels(int l);
+    int getLevels() const { return levels; }
+
+    // HYBRID trajectories: `steps` leapfrog steps of size `step` (0 picks one
+    // from the stiffest mode). fourierMass > 0 turns on Fourier acceleration
+    // with that curvature in the mass term; 0 uses unit masses.
+    void setTrajectory(int steps, double step, double fourierMass);
+    int getLeapfrogSteps() const { return leapfrogSteps; }
+    double getLeapfrogStep() const;
+    double getFourierMass() const { return fourierMass; }
+
+    // One update attempt per free site, in lattice order. For BISECTION,
+    // enough segment moves at random positions to cover the free sites once
+    // on average; for HYBRID, one trajectory.
+    void sweep();
+
+    // Seeds the path from a chain over the same interval with half as many
+    // links: even sites copy it and odd sites are drawn from the free-particle
+    // bridge between their neighbours, so the long-wavelength modes start out
+    // equilibrated. False if the lattices do not match.
+    bool prolongFrom(const MetropolisSampler &coarse);
+
+    // Resets the path to the straight line between the endpoints (or zero for
+    // periodic chains) and clears the acceptance counters.
+    void reset();
+
+    double acceptanceRate() const {
+        return attempts > 0 ? (double)accepted / attempts : 0.0;
+    }
+
+    int numSites() const { return sites; }
+    bool isPeriodic() const { return periodic; }
+    const double *path() const { return x.data(); }
+    const PathState &state() const { return lattice; }
+
+    double action() const { return lattice.action(); }
+
+    // Per-configuration estimators averaged over the sites of the path. The
+    // virial energy needs a differentiable potential (not the square well).
+    double meanX2() const;
+    double virialEnergy() const;
+
+    // Copies the current configuration into row `row` of an ensemble whose
+    // rows hold at least numSites() sites (the periodic image is appended).
+    void copyTo(PathEnsemble &paths, int row) const;
+
+    // Positions, generator state and counters. load expects a sampler built
+    // from the same parameters and continues the chain bit for bit.
+    void save(CheckpointWriter &out) const;
+    bool load(CheckpointReader &in);
+
+private:
+    void updateSite(int t);
+    void bisectionMove();
+    int segmentSite(int start, int k) const;
+    void hybridMove();
+    void prepareMass();
+    void solveMass(const double *rhs, double *out) const;
+    void actionGradient(double *gradient) const;
+
+    SimulationParams params;
+    bool periodic;
+    int sites;
+    UpdateMethod method;
+    double stepSize;
+    int levels;
+    AlignedBuffer<double> x;
+    PathState lattice;
+
+    std::mt19937_64 rng;
+    std::uniform_real_distribution<double> uniform;
+    std::normal_distribution<double> gaussian;
+
+    // Bisection scratch: each placed midpoint's change in dt V.
+    std::vector<double> trialPotential;
+
+    // Hybrid Monte Carlo: trajectory settings, the factored mass matrix
+    // (Thomas pivots plus the Sherman-Morrison correction for the periodic
+    // corners) and per-site momentum, M^-1 p, gradient and saved path.
+    int leapfrogSteps;
+    double leapfrogStep;
+    double fourierMass;
+    bool massReady;
+    double massStiffness, massDiagonal;
+    std::vector<double> massPivot, massUpper, massCorner;
+    double massCornerScale;
+    AlignedBuffer<double> momentum, velocity, gradient, saved;
+
+    uint64_t attempts;
+    uint64_t accepted;
+};
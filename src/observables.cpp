@@ -0,0 +1,225 @@
+#include "observables.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "checkpoint.h"
+
+GroundStateObservables::GroundStateObservables(const Potential &potential,
+                                               uint64_t expectedConfigurations,
+                                               int numBlocks, int histogramBins,
+                                               double histogramRange)
+: potential(potential),
+blockSize(std::max<uint64_t>(1, (expectedConfigurations + numBlocks - 1) / numBlocks)),
+numBlocks(numBlocks), configurations(0), nextConfiguration(0),
+logScale(-HUGE_VAL), weightSquares(0.0),
+blockWeight(numBlocks, 0.0), blockX2(numBlocks, 0.0),
+blockEnergy(numBlocks, 0.0),
+blockHistogram(numBlocks, StreamingHistogram(histogramBins, -histogramRange,
+                                             histogramRange)) {}
+
+void GroundStateObservables::add(const double *path, int begin, int end,
+                                 double weight) {
+    if (end <= begin)
+        return;
+
+    // Runs longer than expected keep filling the last block.
+    const int b = (int)std::min<uint64_t>(nextConfiguration / blockSize, numBlocks - 1);
+    StreamingHistogram &histogram = blockHistogram[b];
+
+    const double siteWeight = weight / (end - begin);
+    double x2 = 0.0, energy = 0.0;
+    for (int t = begin; t < end; t++) {
+        double x = path[t];
+        x2 += x * x;
+        energy += potential.value(x) + 0.5 * x * potential.derivative(x);
+        histogram.add(x, siteWeight);
+    }
+
+    blockWeight[b] += weight;
+    blockX2[b] += x2 * siteWeight;
+    blockEnergy[b] += energy * siteWeight;
+    weightSquares += weight * weight;
+    configurations++;
+    nextConfiguration++;
+}
+
+double GroundStateObservables::useLogScale(double scale) {
+    if (scale == logScale)
+        return 1.0;
+    if (scale > logScale) {
+        rescale(std::exp(logScale - scale));
+        logScale = scale;
+    }
+    return std::exp(scale - logScale);
+}
+
+void GroundStateObservables::rescale(double factor) {
+    for (int b = 0; b < numBlocks; b++) {
+        blockWeight[b] *= factor;
+        blockX2[b] *= factor;
+        blockEnergy[b] *= factor;
+        blockHistogram[b].rescale(factor);
+    }
+    weightSquares *= factor * factor;
+}
+
+void GroundStateObservables::merge(const GroundStateObservables &other) {
+    const double factor = useLogScale(other.logScale);
+    for (int b = 0; b < numBlocks; b++) {
+        blockWeight[b] += factor * other.blockWeight[b];
+        blockX2[b] += factor * other.blockX2[b];
+        blockEnergy[b] += factor * other.blockEnergy[b];
+        blockHistogram[b].merge(other.blockHistogram[b], factor);
+    }
+    weightSquares += factor * factor * other.weightSquares;
+    configurations += other.configurations;
+    nextConfiguration = std::max(nextConfiguration, other.nextConfiguration);
+}
+
+void GroundStateObservables::save(CheckpointWriter &out) const {
+    out.put<uint64_t>(blockSize);
+    out.put<uint64_t>(configurations);
+    out.put<uint64_t>(nextConfiguration);
+    out.put<double>(logScale);
+    out.put<double>(weightSquares);
+    out.putDoubles(blockWeight);
+    out.putDoubles(blockX2);
+    out.putDoubles(blockEnergy);
+    for (int b = 0; b < numBlocks; b++) {
+        blockHistogram[b].save(out);
+    }
+}
+
+void GroundStateObservables::load(CheckpointReader &in) {
+    blockSize = in.get<uint64_t>();
+    configurations = in.get<uint64_t>();
+    nextConfiguration = in.get<uint64_t>();
+    logScale = in.get<double>();
+    weightSquares = in.get<double>();
+    in.getDoubles(blockWeight);
+    in.getDoubles(blockX2);
+    in.getDoubles(blockEnergy);
+    for (int b = 0; b < numBlocks; b++) {
+        blockHistogram[b].load(in);
+    }
+}
+
+void GroundStateObservables::clear() {
+    configurations = 0;
+    logScale = -HUGE_VAL;
+    weightSquares = 0.0;
+    for (int b = 0; b < numBlocks; b++) {
+        blockWeight[b] = 0.0;
+        blockX2[b] = 0.0;
+        blockEnergy[b] = 0.0;
+        blockHistogram[b].clear();
+    }
+}
+
+double GroundStateObservables::effectiveSamples() const {
+    double total = 0.0;
+    for (int b = 0; b < numBlocks; b++) {
+        total += blockWeight[b];
+    }
+    return weightSquares > 0 ? total * total / weightSquares : 0.0;
+}
+
+Estimate GroundStateObservables::jackknife(
+    const std::function<double(int)> &numerator) const {
+    double totalWeight = 0.0, totalValue = 0.0;
+    int filled = 0;
+    for (int b = 0; b < numBlocks; b++) {
+        if (blockWeight[b] > 0) {
+            totalWeight += blockWeight[b];
+            totalValue += numerator(b);
+            filled++;
+        }
+    }
+
+    Estimate result;
+    result.mean = totalWeight > 0 ? totalValue / totalWeight : 0.0;
+    result.error = 0.0;
+    if (filled < 2)
+        return result;
+
+    std::vector<double> leaveOut;
+    double leaveOutMean = 0.0;
+    for (int b = 0; b < numBlocks; b++) {
+        if (blockWeight[b] > 0) {
+            double estimate = (totalValue - numerator(b)) /
+                              (totalWeight - blockWeight[b]);
+            leaveOut.push_back(estimate);
+            leaveOutMean += estimate;
+        }
+    }
+    leaveOutMean /= filled;
+
+    double var = 0.0;
+    for (size_t i = 0; i < leaveOut.size(); i++) {
+        var += (leaveOut[i] - leaveOutMean) * (leaveOut[i] - leaveOutMean);
+    }
+    result.error = std::sqrt(var * (filled - 1) / filled);
+    return result;
+}
+
+Estimate GroundStateObservables::x2() const {
+    return jackknife([this](int b) { return blockX2[b]; });
+}
+
+Estimate GroundStateObservables::energy() const {
+    return jackknife([this](int b) { return blockEnergy[b]; });
+}
+
+void GroundStateObservables::density(std::vector<Estimate> &out) const {
+    out.resize(histogramBins());
+    const double width = binWidth();
+    for (int bin = 0; bin < histogramBins(); bin++) {
+        Estimate e = jackknife(
+            [this, bin](int b) { return blockHistogram[b].count(bin); });
+        out[bin].mean = e.mean / width;
+        out[bin].error = e.error / width;
+    }
+}
+
+LineFit fitLine(const std::vector<double> &x, const std::vector<Estimate> &y) {
+    const size_t n = x.size();
+    bool weighted = true;
+    for (size_t i = 0; i < n; i++) {
+        if (!(y[i].error > 0.0))
+            weighted = false;
+    }
+
+    double s = 0.0, sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double w = weighted ? 1.0 / (y[i].error * y[i].error) : 1.0;
+        s += w;
+        sx += w * x[i];
+        sy += w * y[i].mean;
+        sxx += w * x[i] * x[i];
+        sxy += w * x[i] * y[i].mean;
+    }
+
+    LineFit fit;
+    const double det = s * sxx - sx * sx;
+    fit.intercept.mean = (sxx * sy - sx * sxy) / det;
+    fit.slope.mean = (s * sxy - sx * sy) / det;
+    fit.intercept.error = std::sqrt(sxx / det);
+    fit.slope.error = std::sqrt(s / det);
+
+    fit.chi2 = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double r = y[i].mean - fit.intercept.mean - fit.slope.mean * x[i];
+        fit.chi2 += weighted ? r * r / (y[i].error * y[i].error) : r * r;
+    }
+    fit.dof = (int)n - 2;
+
+    // Unit weights assume sigma = 1 in the units of y; estimate sigma from
+    // the scatter about the line instead, which needs a spare point.
+    if (!weighted) {
+        double sigma = fit.dof > 0 ? std::sqrt(fit.chi2 / fit.dof) : NAN;
+        fit.intercept.error *= sigma;
+        fit.slope.error *= sigma;
+    }
+    return fit;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "accumulators.h"
+#include "potential.h"
+
+struct Estimate {
+    double mean;
+    double error;
+};
+
+// Weighted least-squares line y = intercept + slope * x through points with
+// independent errors. If any error is zero the points get unit weights and
+// the errors come from the scatter about the line, NaN with only two points.
+// chi2 is over dof = points - 2 degrees of freedom.
+struct LineFit {
+    Estimate intercept;
+    Estimate slope;
+    double chi2;
+    int dof;
+};
+
+LineFit fitLine(const std::vector<double> &x, const std::vector<Estimate> &y);
+
+// Ground-state observables from imaginary-time configurations: <x^2>, the
+// virial energy <V + x V'/2> and the |psi_0(x)|^2 histogram. Configurations
+// carry a weight (1 for Markov chains, the importance weight for Euclidean
+// Gaussian ensembles) and are measured on the sites [begin, end).
+//
+// Consecutive configurations are grouped into numBlocks contiguous blocks,
+// and errors come from the jackknife over blocks: every estimate is
+// recomputed with one block left out. That covers both the autocorrelation of
+// chains (as long as blocks outlast it) and the bias of weighted ratios.
+class GroundStateObservables {
+public:
+    GroundStateObservables(const Potential &potential,
+                           uint64_t expectedConfigurations, int numBlocks = 20,
+                           int histogramBins = 100, double histogramRange = 4.0);
+
+    void add(const double *path, int begin, int end, double weight = 1.0);
+
+    // Importance weights only mean something relative to each other, and a
+    // batch's are relative to exp(logScale) of its largest. Returns the factor
+    // that puts such weights on the running scale of everything added so
+    // far, rescaling what is already accumulated when logScale is the new
+    // largest. Estimates then do not depend on how the configurations were
+    // split into batches or processes.
+    double useLogScale(double logScale);
+
+    // Position of the next configuration in the full run, which decides its
+    // block. A process measuring a slice of the run seeks to the slice's
+    // start so that blocks line up across processes.
+    void seek(uint64_t configuration) { nextConfiguration = configuration; }
+
+    // Adds another instance's blocks, on the larger of the two log-scales;
+    // both must have the same constructor arguments.
+    void merge(const GroundStateObservables &other);
+
+    // Drops every configuration, keeping the block and histogram layout.
+    void clear();
+
+    // load expects an instance constructed with the same arguments.
+    void save(CheckpointWriter &out) const;
+    void load(CheckpointReader &in);
+
+    uint64_t count() const { return configurations; }
+
+    // (sum w)^2 / sum w^2, the number of equally weighted configurations the
+    // weighted ones are worth.
+    double effectiveSamples() const;
+
+    Estimate x2() const;
+    Estimate energy() const;
+
+    // Histogram over [-histogramRange, histogramRange]; density[b] is
+    // normalized so that sum density * binWidth = 1 for sites in range.
+    int histogramBins() const { return blockHistogram[0].bins(); }
+    double binWidth() const { return blockHistogram[0].binWidth(); }
+    double binCenter(int b) const { return blockHistogram[0].binCenter(b); }
+    void density(std::vector<Estimate> &out) const;
+
+private:
+    void rescale(double factor);
+
+    // Jackknife of sum(numerator(b)) / sum(weights) over filled blocks.
+    Estimate jackknife(const std::function<double(int)> &numerator) const;
+
+    Potential potential;
+    uint64_t blockSize;
+    int numBlocks;
+
+    uint64_t configurations;
+    uint64_t nextConfiguration;
+    double logScale;
+    double weightSquares;
+    std::vector<double> blockWeight;
+    std::vector<double> blockX2;
+    std::vector<double> blockEnergy;
+    std::vector<StreamingHistogram> blockHistogram;
+};
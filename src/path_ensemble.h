@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+template <typename T> class AlignedBuffer {
+public:
+    static const size_t ALIGNMENT = 64;
+
+    AlignedBuffer() : storage(nullptr), items(nullptr), count(0), capacity(0) {}
+
+    ~AlignedBuffer() { ::operator delete(storage); }
+
+    AlignedBuffer(AlignedBuffer &&other)
+    : storage(other.storage), items(other.items), count(other.count),
+    capacity(other.capacity) {
+        other.storage = nullptr;
+        other.items = nullptr;
+        other.count = 0;
+        other.capacity = 0;
+    }
+
+    AlignedBuffer &operator=(AlignedBuffer &&other) {
+        if (this != &other) {
+            ::operator delete(storage);
+            storage = other.storage;
+            items = other.items;
+            count = other.count;
+            capacity = other.capacity;
+            other.storage = nullptr;
+            other.items = nullptr;
+            other.count = 0;
+            other.capacity = 0;
+        }
+        return *this;
+    }
+
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    // Only grows the allocation; shrinking keeps the old block so that
+    // regenerating an ensemble of the same shape never touches the allocator.
+    void resize(size_t n) {
+        if (n > capacity) {
+            void *block = ::operator new(n * sizeof(T) + ALIGNMENT);
+            uintptr_t address = reinterpret_cast<uintptr_t>(block);
+            address = (address + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1);
+            T *aligned = reinterpret_cast<T *>(address);
+            if (count > 0)
+                std::copy(items, items + count, aligned);
+            ::operator delete(storage);
+            storage = block;
+            items = aligned;
+            capacity = n;
+        }
+        count = n;
+    }
+
+    void fill(const T &value) { std::fill(items, items + count, value); }
+
+    T *data() { return items; }
+    const T *data() const { return items; }
+    size_t size() const { return count; }
+
+    T &operator[](size_t i) { return items[i]; }
+    const T &operator[](size_t i) const { return items[i]; }
+
+private:
+    void *storage;
+    T *items;
+    size_t count;
+    size_t capacity;
+};
+
+// All paths of one regeneration live in a single row-major
+// numPaths x (timeSteps + 1) block; rows are padded so every path starts on
+// a cache line. Actions and amplitudes are kept in separate arrays.
+class PathEnsemble {
+public:
+    static const int ROW_ALIGN_DOUBLES = AlignedBuffer<double>::ALIGNMENT / sizeof(double);
+
+    PathEnsemble() : pathCount(0), stepCount(0), rowStride(0) {}
+
+    void resize(int numPaths, int timeSteps) {
+        pathCount = numPaths;
+        stepCount = timeSteps;
+        size_t sites = (size_t)timeSteps + 1;
+        rowStride = (sites + ROW_ALIGN_DOUBLES - 1) / ROW_ALIGN_DOUBLES * ROW_ALIGN_DOUBLES;
+
+        positionData.resize((size_t)numPaths * rowStride);
+        actionData.resize(numPaths);
+        amplitudeRe.resize(numPaths);
+        amplitudeIm.resize(numPaths);
+    }
+
+    int numPaths() const { return pathCount; }
+    int timeSteps() const { return stepCount; }
+    int numSites() const { return stepCount + 1; }
+    size_t stride() const { return rowStride; }
+    bool empty() const { return pathCount == 0; }
+
+    double *path(int i) { return positionData.data() + (size_t)i * rowStride; }
+    const double *path(int i) const {
+        return positionData.data() + (size_t)i * rowStride;
+    }
+
+    double *positions() { return positionData.data(); }
+    const double *positions() const { return positionData.data(); }
+
+    double *actions() { return actionData.data(); }
+    const double *actions() const { return actionData.data(); }
+
+    double *amplitudesRe() { return amplitudeRe.data(); }
+    const double *amplitudesRe() const { return amplitudeRe.data(); }
+    double *amplitudesIm() { return amplitudeIm.data(); }
+    const double *amplitudesIm() const { return amplitudeIm.data(); }
+
+    std::complex<double> amplitude(int i) const {
+        return std::complex<double>(amplitudeRe[i], amplitudeIm[i]);
+    }
+
+    void setAmplitude(int i, const std::complex<double> &value) {
+        amplitudeRe[i] = value.real();
+        amplitudeIm[i] = value.imag();
+    }
+
+private:
+    int pathCount;
+    int stepCount;
+    size_t rowStride;
+    AlignedBuffer<double> positionData;
+    AlignedBuffer<double> actionData;
+    AlignedBuffer<double> amplitudeRe;
+    AlignedBuffer<double> amplitudeIm;
+};
@@ -0,0 +1,140 @@
+#include "path_generator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "action_kernel.h"
+#include "profiler.h"
+
+void generateRandomPath(double *path, int timeSteps, double x0, double xf,
+                        double sigma, PathNoise &noise, uint64_t pathIndex) {
+    noise.normals(pathIndex, timeSteps - 1, path + 1);
+    path[0] = x0;
+    path[timeSteps] = xf;
+
+    for (int t = 1; t < timeSteps; t++) {
+        double alpha = (double)t / timeSteps;
+        path[t] = (1 - alpha) * x0 + alpha * xf + path[t] * sigma;
+    }
+}
+
+// -log q(path) up to a constant, for the Gaussian density generateRandomPath
+// draws interior sites from.
+static double proposalLogWeight(const double *path,
+                                const SimulationParams &params) {
+    if (params.sigma <= 0)
+        return 0.0;
+    double sum = 0.0;
+    for (int t = 1; t < params.timeSteps; t++) {
+        double alpha = (double)t / params.timeSteps;
+        double d = path[t] - ((1 - alpha) * params.x0 + alpha * params.xf);
+        sum += d * d;
+    }
+    return 0.5 * sum / (params.sigma * params.sigma);
+}
+
+PathGenerator::PathGenerator(int numThreads)
+: threads(numThreads), lastLogScale(0.0) {}
+
+std::complex<double> PathGenerator::generate(PathEnsemble &paths,
+                                             const SimulationParams &params,
+                                             uint64_t stream,
+                                             uint64_t firstChunk) {
+    ScopedTimer timer("generate");
+    paths.resize(params.numPaths, params.timeSteps);
+
+    const int numChunks = (params.numPaths + CHUNK_PATHS - 1) / CHUNK_PATHS;
+    partialSums.assign(numChunks, std::complex<double>(0, 0));
+    partialMax.assign(numChunks, -HUGE_VAL);
+
+    const ActionKernel &kernel = actionKernel();
+    const ActionCoefficients coefficients =
+    params.euclidean ? makeEuclideanCoefficients(params.mass, params.dt)
+                     : makeActionCoefficients(params.mass, params.dt);
+
+    threads.parallelFor(numChunks, [&](int chunk) {
+        int begin = chunk * CHUNK_PATHS;
+        int end = std::min(begin + CHUNK_PATHS, params.numPaths);
+
+        PathNoise noise(params.seed, stream);
+        const uint64_t firstPath = firstChunk * CHUNK_PATHS;
+
+        {
+            ScopedTimer sampleTimer("sample");
+            for (int i = begin; i < end; i++) {
+                generateRandomPath(paths.path(i), params.timeSteps, params.x0,
+                                   params.xf, params.sigma, noise, firstPath + i);
+            }
+        }
+
+        {
+            ScopedTimer actionTimer("action");
+            kernel.computeActions(paths.path(begin), paths.stride(),
+                                  end - begin, paths.numSites(), coefficients,
+                                  params.potential, paths.actions() + begin);
+            if (!params.euclidean) {
+                kernel.computePhases(paths.actions() + begin, end - begin,
+                                     1.0 / params.hbar,
+                                     paths.amplitudesRe() + begin,
+                                     paths.amplitudesIm() + begin);
+            }
+        }
+
+        if (params.euclidean) {
+            // Log-weights for now; exponentiated once the largest is known.
+            double largest = -HUGE_VAL;
+            for (int i = begin; i < end; i++) {
+                double logWeight = -paths.actions()[i] / params.hbar +
+                                   proposalLogWeight(paths.path(i), params);
+                paths.setAmplitude(i, logWeight);
+                largest = std::max(largest, logWeight);
+            }
+            partialMax[chunk] = largest;
+            return;
+        }
+
+        ScopedTimer normalizeTimer("normalize");
+        std::complex<double> sum(0, 0);
+        for (int i = begin; i < end; i++) {
+            sum += paths.amplitude(i);
+        }
+        partialSums[chunk] = sum;
+    });
+
+    if (params.euclidean) {
+        ScopedTimer normalizeTimer("normalize");
+        const double largest =
+        *std::max_element(partialMax.begin(), partialMax.end());
+        lastLogScale = largest;
+        threads.parallelFor(numChunks, [&](int chunk) {
+            int begin = chunk * CHUNK_PATHS;
+            int end = std::min(begin + CHUNK_PATHS, params.numPaths);
+            double sum = 0.0;
+            for (int i = begin; i < end; i++) {
+                double weight = std::exp(paths.amplitudesRe()[i] - largest);
+                paths.amplitudesRe()[i] = weight;
+                sum += weight;
+            }
+            partialSums[chunk] = sum;
+        });
+    }
+
+    std::complex<double> sum(0, 0);
+    for (int chunk = 0; chunk < numChunks; chunk++) {
+        sum += partialSums[chunk];
+    }
+
+    if (std::abs(sum) > 1e-10) {
+        ScopedTimer normalizeTimer("normalize");
+        const std::complex<double> scale = 1.0 / sum;
+        threads.parallelFor(numChunks, [&](int chunk) {
+            int begin = chunk * CHUNK_PATHS;
+            int end = std::min(begin + CHUNK_PATHS, params.numPaths);
+            for (int i = begin; i < end; i++) {
+                paths.setAmplitude(i, paths.amplitude(i) * scale);
+            }
+        });
+    }
+
+    return sum;
+}
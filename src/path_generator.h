@@ -0,0 +1,56 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "path_ensemble.h"
+#include "random.h"
+#include "simulation_params.h"
+#include "thread_pool.h"
+
+// Gaussian fluctuations around the straight line from x0 to xf; endpoints
+// stay fixed. path must hold timeSteps + 1 sites. Interior site t uses noise
+// slice t - 1 of pathIndex.
+void generateRandomPath(double *path, int timeSteps, double x0, double xf,
+                        double sigma, PathNoise &noise, uint64_t pathIndex);
+
+// Fills an ensemble in parallel. Path i draws its noise from the counter-based
+// generator at (seed, stream, i), and the amplitude sum is reduced over fixed
+// CHUNK_PATHS blocks in chunk order, so the output for a given seed does not
+// depend on the number of threads.
+class PathGenerator {
+public:
+    static const int CHUNK_PATHS = 256;
+
+    explicit PathGenerator(int numThreads = 0);
+
+    int numThreads() const { return threads.size(); }
+
+    // Euclidean only: log of the largest unnormalized weight in the last
+    // generate(), i.e. the reference its returned sum is relative to.
+    double logWeightScale() const { return lastLogScale; }
+    ThreadPool &pool() { return threads; }
+
+    // Samples params.numPaths paths, evaluates their actions and normalizes
+    // the amplitudes by their sum, which is returned (before normalization).
+    //
+    // With params.euclidean the actions are S_E and the amplitudes become
+    // real importance weights exp(-S_E/hbar) / q(path), where q is the
+    // Gaussian density the path was drawn from, so weighted averages estimate
+    // imaginary-time expectation values. Weights are scaled by the largest
+    // one before summing, so the returned sum is relative to that path.
+    //
+    // firstChunk offsets the path indices, so a long run can be produced in
+    // batches: batch b of size k * CHUNK_PATHS with firstChunk = b * k holds
+    // exactly the paths a single ensemble would have at those rows.
+    std::complex<double> generate(PathEnsemble &paths,
+                                  const SimulationParams &params,
+                                  uint64_t stream, uint64_t firstChunk = 0);
+
+private:
+    ThreadPool threads;
+    std::vector<std::complex<double>> partialSums;
+    std::vector<double> partialMax;
+    double lastLogScale;
+};
@@ -0,0 +1,109 @@
+#include "path_geometry.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "path_generator.h"
+
+static const double TWO_PI = 6.28318530717958647693;
+static const double TWO_THIRDS_PI = 2.0943951023931954923;
+
+static unsigned char toByte(float value) {
+    return (unsigned char)(value * 255.0f + 0.5f);
+}
+
+// atan2(im, re) in turns, to within 1e-5 rad: an odd polynomial on [0, 1]
+// after folding into the first octant. The table spacing is 6e-3 rad.
+static double phaseTurns(double re, double im) {
+    double ax = std::fabs(re), ay = std::fabs(im);
+    double hi = std::max(ax, ay);
+    if (hi == 0.0)
+        return 0.0;
+
+    double a = std::min(ax, ay) / hi;
+    double s = a * a;
+    double r = ((-0.0464964749 * s + 0.15931422) * s - 0.327622764) * s * a + a;
+    if (ay > ax)
+        r = 0.25 * TWO_PI - r;
+    if (re < 0)
+        r = 0.5 * TWO_PI - r;
+    if (im < 0)
+        r = -r;
+    return r / TWO_PI;
+}
+
+AmplitudePalette::AmplitudePalette(float gain, float floor, float opacity)
+: gain(gain), floor(floor), opacity(opacity) {
+    for (int k = 0; k < PHASE_ENTRIES; k++) {
+        double phase = TWO_PI * k / PHASE_ENTRIES;
+        hues[k][0] = (float)(0.5 + 0.5 * std::cos(phase));
+        hues[k][1] = (float)(0.5 + 0.5 * std::cos(phase + TWO_THIRDS_PI));
+        hues[k][2] = (float)(0.5 + 0.5 * std::cos(phase + 2 * TWO_THIRDS_PI));
+    }
+}
+
+const float *AmplitudePalette::hue(double re, double im) const {
+    int k = (int)std::floor(phaseTurns(re, im) * PHASE_ENTRIES + 0.5) &
+            (PHASE_ENTRIES - 1);
+    return hues[k];
+}
+
+PathColor AmplitudePalette::color(double re, double im) const {
+    const float *rgb = hue(re, im);
+
+    float alpha = gain * (float)std::sqrt(re * re + im * im);
+    alpha = std::min(1.0f, std::max(floor, alpha));
+
+    PathColor c;
+    c.r = toByte(rgb[0] * alpha);
+    c.g = toByte(rgb[1] * alpha);
+    c.b = toByte(rgb[2] * alpha);
+    c.a = toByte(alpha * opacity);
+    return c;
+}
+
+void AmplitudePalette::colorEnsemble(const PathEnsemble &paths,
+                                     ThreadPool &pool, PathColor *out) const {
+    const int numPaths = paths.numPaths();
+    const int chunk = PathGenerator::CHUNK_PATHS;
+    const double *re = paths.amplitudesRe();
+    const double *im = paths.amplitudesIm();
+
+    pool.parallelFor((numPaths + chunk - 1) / chunk, [&](int c) {
+        int end = std::min((c + 1) * chunk, numPaths);
+        for (int i = c * chunk; i < end; i++) {
+            out[i] = color(re[i], im[i]);
+        }
+    });
+}
+
+void buildPathVertices(const PathEnsemble &paths, int i, PathColor color,
+                       PathVertex *out) {
+    const int numSites = paths.numSites();
+    const double *path = paths.path(i);
+
+    PathVertex v;
+    v.r = color.r;
+    v.g = color.g;
+    v.b = color.b;
+    v.a = color.a;
+    for (int t = 0; t < numSites; t++) {
+        v.x = (float)path[t];
+        v.y = (float)(-2.5 + 5.0 * t / (numSites - 1));
+        out[t] = v;
+    }
+}
+
+void buildEnsembleVertices(const PathEnsemble &paths, const PathColor *colors,
+                           ThreadPool &pool, PathVertex *out) {
+    const int numPaths = paths.numPaths();
+    const int numSites = paths.numSites();
+    const int chunk = PathGenerator::CHUNK_PATHS;
+
+    pool.parallelFor((numPaths + chunk - 1) / chunk, [&](int c) {
+        int end = std::min((c + 1) * chunk, numPaths);
+        for (int i = c * chunk; i < end; i++) {
+            buildPathVertices(paths, i, colors[i], out + (size_t)i * numSites);
+        }
+    });
+}
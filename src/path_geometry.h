@@ -0,0 +1,53 @@
+#pragma once
+
+#include "path_ensemble.h"
+#include "thread_pool.h"
+
+// Packed RGBA8 colour, premultiplied by its alpha.
+struct PathColor {
+    unsigned char r, g, b, a;
+};
+
+// Interleaved position/colour vertex shared by the viewer's vertex buffers.
+struct PathVertex {
+    float x, y;
+    unsigned char r, g, b, a;
+};
+
+// Colours paths by amplitude: hue from the phase through a lookup table,
+// opacity alpha = clamp(gain * |A|, floor, 1) from the magnitude. The colour
+// is premultiplied by alpha and the stored opacity is alpha * opacity.
+// A path costs one table lookup instead of an arg, an abs and three cosines.
+class AmplitudePalette {
+public:
+    // Power of two; adjacent entries are 2 pi / 1024 apart, well below one
+    // step of an 8-bit channel.
+    enum { PHASE_ENTRIES = 1024 };
+
+    explicit AmplitudePalette(float gain = 10.0f, float floor = 0.0f,
+                              float opacity = 1.0f);
+
+    PathColor color(double re, double im) const;
+
+    // The table's r, g, b for the amplitude's phase, in [0, 1].
+    const float *hue(double re, double im) const;
+
+    // One linear pass over the ensemble's amplitudes, split into the
+    // generator's chunks across the pool.
+    void colorEnsemble(const PathEnsemble &paths, ThreadPool &pool,
+                       PathColor *out) const;
+
+private:
+    float gain, floor, opacity;
+    float hues[PHASE_ENTRIES][3];
+};
+
+// Writes numSites vertices for path i in `color`: x from the path, time mapped
+// onto y in [-2.5, 2.5].
+void buildPathVertices(const PathEnsemble &paths, int i, PathColor color,
+                       PathVertex *out);
+
+// Builds every path into out (numPaths * numSites vertices, path-major),
+// colour i from colors[i], split into the generator's chunks across the pool.
+void buildEnsembleVertices(const PathEnsemble &paths, const PathColor *colors,
+                           ThreadPool &pool, PathVertex *out);
@@ -0,0 +1,104 @@
+#include "path_state.h"
+
+#include <cstddef>
+
+PathState::PathState()
+: x(nullptr), sites(0), periodic(false), kinetic(0.0), potential(0.0),
+V(nullptr), total(0.0), batching(false) {}
+
+void PathState::bind(double *positions, int numSites, bool periodic,
+                     double kinetic, double potential, const Potential &V) {
+    x = positions;
+    sites = numSites;
+    this->periodic = periodic;
+    this->kinetic = kinetic;
+    this->potential = potential;
+    this->V = &V;
+    batching = false;
+    undo.clear();
+    recompute();
+}
+
+void PathState::recompute() {
+    links.assign(sites, 0.0);
+    sitesAction.assign(sites, 0.0);
+    total = 0.0;
+
+    for (int t = 0; t < sites; t++) {
+        if (hasRightLink(t)) {
+            double d = x[rightOf(t)] - x[t];
+            links[t] = kinetic * d * d;
+            total += links[t];
+        }
+        if (hasPotential(t)) {
+            sitesAction[t] = potential * V->value(x[t]);
+            total += sitesAction[t];
+        }
+    }
+}
+
+double PathState::deltaPotential(int site, double value) const {
+    if (!hasPotential(site))
+        return 0.0;
+    return potential * V->value(value) - sitesAction[site];
+}
+
+double PathState::deltaAction(int site, double value) const {
+    double delta = deltaPotential(site, value);
+    if (hasLeftLink(site)) {
+        int l = leftOf(site);
+        double d = value - x[l];
+        delta += kinetic * d * d - links[l];
+    }
+    if (hasRightLink(site)) {
+        double d = x[rightOf(site)] - value;
+        delta += kinetic * d * d - links[site];
+    }
+    return delta;
+}
+
+void PathState::set(int site, double value) {
+    if (batching) {
+        Change change = {site, x[site]};
+        undo.push_back(change);
+    }
+
+    x[site] = value;
+
+    if (hasLeftLink(site)) {
+        int l = leftOf(site);
+        double d = value - x[l];
+        double link = kinetic * d * d;
+        total += link - links[l];
+        links[l] = link;
+    }
+    if (hasRightLink(site)) {
+        double d = x[rightOf(site)] - value;
+        double link = kinetic * d * d;
+        total += link - links[site];
+        links[site] = link;
+    }
+    if (hasPotential(site)) {
+        double term = potential * V->value(value);
+        total += term - sitesAction[site];
+        sitesAction[site] = term;
+    }
+}
+
+void PathState::beginBatch() {
+    batching = true;
+    undo.clear();
+}
+
+void PathState::commit() {
+    batching = false;
+    undo.clear();
+}
+
+void PathState::rollback() {
+    batching = false;
+    for (size_t i = undo.size(); i-- > 0;) {
+        set(undo[i].site, undo[i].value);
+    }
+    undo.clear();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+#include "potential.h"
+
+// Lattice action of one path with cached per-link kinetic and per-site
+// potential terms:
+//   S = kinetic * sum_links (x_{t+1} - x_t)^2 + potential * sum_sites V(x_t).
+// kinetic = m/(2 dt) with potential = -dt gives the real-time action used for
+// amplitudes; potential = +dt gives the Euclidean action used by the Markov
+// chain samplers. Positions are not owned: the state works in place on the
+// bound array, so changes show up directly in the caller's path.
+//
+// Open paths have fixed endpoints and skip the potential of site 0, matching
+// the action kernel; periodic paths wrap the last link back to site 0.
+class PathState {
+public:
+    PathState();
+
+    // V must outlive the binding.
+    void bind(double *positions, int numSites, bool periodic, double kinetic,
+              double potential, const Potential &V);
+
+    int numSites() const { return sites; }
+    bool isPeriodic() const { return periodic; }
+    double position(int site) const { return x[site]; }
+    const double *positions() const { return x; }
+
+    double action() const { return total; }
+    double linkAction(int link) const { return links[link]; }
+    double siteAction(int site) const { return sitesAction[site]; }
+
+    // Change in S if `site` moved to `value`; O(1) and side-effect free.
+    double deltaAction(int site, double value) const;
+    double deltaPotential(int site, double value) const;
+
+    // Moves a site and updates the cached terms and the running total. Inside
+    // a batch the old value is logged so the batch can be rolled back.
+    void set(int site, double value);
+
+    void beginBatch();
+    void commit();
+    void rollback();
+    bool inBatch() const { return batching; }
+
+    // Rebuilds every cached term from the positions, discarding the
+    // round-off accumulated by incremental updates.
+    void recompute();
+
+    // Resuming from a checkpoint: bind() rebuilds the cached terms exactly,
+    // but the running total carries its own round-off and is restored as is.
+    void restoreTotal(double value) { total = value; }
+
+private:
+    int leftOf(int site) const { return site == 0 ? sites - 1 : site - 1; }
+    int rightOf(int site) const { return site + 1 == sites ? 0 : site + 1; }
+    bool hasLeftLink(int site) const { return periodic || site > 0; }
+    bool hasRightLink(int site) const { return periodic || site + 1 < sites; }
+    bool hasPotential(int site) const { return periodic || site > 0; }
+
+    struct Change {
+        int site;
+        double value;
+    };
+
+    double *x;
+    int sites;
+    bool periodic;
+    double kinetic;
+    double potential;
+    const Potential *V;
+
+    std::vector<double> links;
+    std::vector<double> sitesAction;
+    double total;
+
+    bool batching;
+    std::vector<Change> undo;
+};
@@ -0,0 +1,294 @@
+#include "potential.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+bool PotentialTable::build(const std::vector<double> &xs,
+                           const std::vector<double> &vs) {
+    const int n = (int)xs.size();
+    if (n < 2 || vs.size() != xs.size())
+        return false;
+    for (int i = 1; i < n; i++) {
+        if (!(xs[i] > xs[i - 1]))
+            return false;
+    }
+
+    knots = xs;
+    values = vs;
+    curvature.assign(n, 0.0);
+
+    // Tridiagonal solve for the second derivatives with natural ends.
+    std::vector<double> diag(n, 1.0), rhs(n, 0.0), upper(n, 0.0);
+    for (int i = 1; i + 1 < n; i++) {
+        double h0 = xs[i] - xs[i - 1];
+        double h1 = xs[i + 1] - xs[i];
+        double lower = h0 / 6.0;
+        diag[i] = (h0 + h1) / 3.0 - lower * upper[i - 1];
+        upper[i] = h1 / 6.0 / diag[i];
+        rhs[i] = ((vs[i + 1] - vs[i]) / h1 - (vs[i] - vs[i - 1]) / h0 -
+                  lower * rhs[i - 1]) / diag[i];
+    }
+    for (int i = n - 2; i > 0; i--) {
+        curvature[i] = rhs[i] - upper[i] * curvature[i + 1];
+    }
+    return true;
+}
+
+bool PotentialTable::load(const std::string &path, std::string &error) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::vector<double> xs, vs;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        for (size_t i = 0; i < line.size(); i++) {
+            if (line[i] == ',')
+                line[i] = ' ';
+        }
+        std::istringstream fields(line);
+        double x, v;
+        if (!(fields >> x >> v)) {
+            error = path + ": expected \"x V\" on every line";
+            return false;
+        }
+        xs.push_back(x);
+        vs.push_back(v);
+    }
+
+    if (!build(xs, vs)) {
+        error = path + ": need at least two samples with increasing x";
+        return false;
+    }
+    return true;
+}
+
+int PotentialTable::segment(double x) const {
+    int lo = 0, hi = (int)knots.size() - 1;
+    while (hi - lo > 1) {
+        int mid = (lo + hi) / 2;
+        if (knots[mid] <= x)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+double PotentialTable::value(double x) const {
+    if (x <= knots.front())
+        return values.front();
+    if (x >= knots.back())
+        return values.back();
+
+    int i = segment(x);
+    double h = knots[i + 1] - knots[i];
+    double u = (knots[i + 1] - x) / h;
+    double w = 1.0 - u;
+    return u * values[i] + w * values[i + 1] +
+           ((u * u * u - u) * curvature[i] + (w * w * w - w) * curvature[i + 1]) *
+           h * h / 6.0;
+}
+
+double PotentialTable::derivative(double x) const {
+    if (x <= knots.front() || x >= knots.back())
+        return 0.0;
+
+    int i = segment(x);
+    double h = knots[i + 1] - knots[i];
+    double u = (knots[i + 1] - x) / h;
+    double w = 1.0 - u;
+    return (values[i + 1] - values[i]) / h +
+           ((1.0 - 3.0 * u * u) * curvature[i] + (3.0 * w * w - 1.0) * curvature[i + 1]) *
+           h / 6.0;
+}
+
+Potential Potential::harmonic(double k) {
+    Potential p;
+    p.kind = POTENTIAL_HARMONIC;
+    p.a = k;
+    return p;
+}
+
+Potential Potential::anharmonic(double lambda) {
+    Potential p;
+    p.kind = POTENTIAL_ANHARMONIC;
+    p.a = lambda;
+    return p;
+}
+
+Potential Potential::doubleWell(double lambda, double minimum) {
+    Potential p;
+    p.kind = POTENTIAL_DOUBLE_WELL;
+    p.a = lambda;
+    p.b = minimum;
+    return p;
+}
+
+Potential Potential::squareWell(double halfWidth, double height) {
+    Potential p;
+    p.kind = POTENTIAL_SQUARE_WELL;
+    p.a = halfWidth;
+    p.b = height;
+    return p;
+}
+
+Potential Potential::morse(double depth, double alpha, double center) {
+    Potential p;
+    p.kind = POTENTIAL_MORSE;
+    p.a = depth;
+    p.b = alpha;
+    p.c = center;
+    return p;
+}
+
+Potential Potential::tabulated(const std::shared_ptr<const PotentialTable> &t) {
+    Potential p;
+    p.kind = POTENTIAL_TABULATED;
+    p.table = t;
+    return p;
+}
+
+Potential Potential::withDefaults(PotentialKind kind) {
+    switch (kind) {
+        case POTENTIAL_ANHARMONIC:
+            return anharmonic();
+        case POTENTIAL_DOUBLE_WELL:
+            return doubleWell();
+        case POTENTIAL_SQUARE_WELL:
+            return squareWell();
+        case POTENTIAL_MORSE:
+            return morse();
+        case POTENTIAL_HARMONIC:
+        case POTENTIAL_TABULATED:
+            break;
+    }
+    return harmonic();
+}
+
+double Potential::value(double x) const {
+    switch (kind) {
+        case POTENTIAL_HARMONIC:
+            return 0.5 * a * x * x;
+        case POTENTIAL_ANHARMONIC:
+            return 0.5 * x * x + a * x * x * x * x;
+        case POTENTIAL_DOUBLE_WELL: {
+            double d = x * x - b * b;
+            return a * d * d;
+        }
+        case POTENTIAL_SQUARE_WELL:
+            return std::fabs(x) < a ? 0.0 : b;
+        case POTENTIAL_MORSE: {
+            double e = 1.0 - std::exp(-b * (x - c));
+            return a * e * e;
+        }
+        case POTENTIAL_TABULATED:
+            return table ? table->value(x) : 0.0;
+    }
+    return 0.0;
+}
+
+// The square well's derivative is taken as zero everywhere, so virial
+// estimators do not apply to it.
+double Potential::derivative(double x) const {
+    switch (kind) {
+        case POTENTIAL_HARMONIC:
+            return a * x;
+        case POTENTIAL_ANHARMONIC:
+            return x + 4.0 * a * x * x * x;
+        case POTENTIAL_DOUBLE_WELL:
+            return 4.0 * a * x * (x * x - b * b);
+        case POTENTIAL_SQUARE_WELL:
+            return 0.0;
+        case POTENTIAL_MORSE: {
+            double e = std::exp(-b * (x - c));
+            return 2.0 * a * b * e * (1.0 - e);
+        }
+        case POTENTIAL_TABULATED:
+            return table ? table->derivative(x) : 0.0;
+    }
+    return 0.0;
+}
+
+const char *Potential::name() const { return potentialName(kind); }
+
+const char *potentialName(PotentialKind kind) {
+    switch (kind) {
+        case POTENTIAL_HARMONIC:
+            return "harmonic";
+        case POTENTIAL_ANHARMONIC:
+            return "anharmonic";
+        case POTENTIAL_DOUBLE_WELL:
+            return "doublewell";
+        case POTENTIAL_SQUARE_WELL:
+            return "squarewell";
+        case POTENTIAL_MORSE:
+            return "morse";
+        case POTENTIAL_TABULATED:
+            return "tabulated";
+    }
+    return "harmonic";
+}
+
+bool parsePotentialKind(const char *name, PotentialKind &kind) {
+    for (int i = POTENTIAL_HARMONIC; i <= POTENTIAL_TABULATED; i++) {
+        if (std::strcmp(name, potentialName((PotentialKind)i)) == 0) {
+            kind = (PotentialKind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isPotentialOption(const std::string &option) {
+    return option == "--potential" || option == "--potential-file" ||
+           option == "--potential-params";
+}
+
+bool applyPotentialOption(const std::string &option, const char *value,
+                          Potential &potential, std::string &error) {
+    if (option == "--potential") {
+        PotentialKind kind;
+        if (!parsePotentialKind(value, kind) || kind == POTENTIAL_TABULATED) {
+            error = std::string("Unknown potential ") + value +
+                    " (harmonic, anharmonic, doublewell, squarewell, morse)";
+            return false;
+        }
+        potential = Potential::withDefaults(kind);
+        return true;
+    }
+
+    if (option == "--potential-file") {
+        std::shared_ptr<PotentialTable> table(new PotentialTable());
+        if (!table->load(value, error))
+            return false;
+        potential = Potential::tabulated(table);
+        return true;
+    }
+
+    if (option == "--potential-params") {
+        double *params[3] = {&potential.a, &potential.b, &potential.c};
+        std::string list = value;
+        std::istringstream in(list);
+        std::string item;
+        int count = 0;
+        while (std::getline(in, item, ',')) {
+            if (count == 3) {
+                error = "--potential-params takes at most three values";
+                return false;
+            }
+            *params[count++] = std::atof(item.c_str());
+        }
+        return true;
+    }
+
+    error = "Unknown option " + option;
+    return false;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Built-in potentials and the meaning of Potential::a, b, c for each:
+//   HARMONIC     V = a x^2 / 2                    (a = k, default 1)
+//   ANHARMONIC   V = x^2 / 2 + a x^4              (a = lambda, default 0.1)
+//   DOUBLE_WELL  V = a (x^2 - b^2)^2              (a = 1, b = 1)
+//   SQUARE_WELL  V = 0 for |x| < a, b outside     (a = 1, b = 5)
+//   MORSE        V = a (1 - exp(-b (x - c)))^2    (a = 5, b = 1, c = 0)
+//   TABULATED    cubic spline through user samples (see PotentialTable)
+enum PotentialKind {
+    POTENTIAL_HARMONIC = 0,
+    POTENTIAL_ANHARMONIC,
+    POTENTIAL_DOUBLE_WELL,
+    POTENTIAL_SQUARE_WELL,
+    POTENTIAL_MORSE,
+    POTENTIAL_TABULATED
+};
+
+// Natural cubic spline through sampled (x, V) pairs, held constant beyond
+// the first and last sample.
+class PotentialTable {
+public:
+    // xs must be strictly increasing; needs at least two samples.
+    bool build(const std::vector<double> &xs, const std::vector<double> &vs);
+
+    // Reads "x V" pairs, one per line, separated by whitespace or a comma;
+    // lines starting with '#' are skipped.
+    bool load(const std::string &path, std::string &error);
+
+    double value(double x) const;
+    double derivative(double x) const;
+
+    bool empty() const { return knots.empty(); }
+    double minX() const { return knots.front(); }
+    double maxX() const { return knots.back(); }
+
+private:
+    int segment(double x) const;
+
+    std::vector<double> knots;
+    std::vector<double> values;
+    std::vector<double> curvature;
+};
+
+// A potential is a small value type: a kind, up to three shape parameters
+// and, for TABULATED, a shared immutable table. The action kernels switch
+// on the kind once per call and run a loop specialized for it.
+struct Potential {
+    PotentialKind kind;
+    double a, b, c;
+    std::shared_ptr<const PotentialTable> table;
+
+    Potential() : kind(POTENTIAL_HARMONIC), a(1.0), b(0.0), c(0.0) {}
+
+    static Potential harmonic(double k = 1.0);
+    static Potential anharmonic(double lambda = 0.1);
+    static Potential doubleWell(double lambda = 1.0, double minimum = 1.0);
+    static Potential squareWell(double halfWidth = 1.0, double height = 5.0);
+    static Potential morse(double depth = 5.0, double alpha = 1.0,
+                           double center = 0.0);
+    static Potential tabulated(const std::shared_ptr<const PotentialTable> &t);
+
+    // Built-in kind with its default parameters.
+    static Potential withDefaults(PotentialKind kind);
+
+    double value(double x) const;
+    double derivative(double x) const;
+
+    const char *name() const;
+};
+
+const char *potentialName(PotentialKind kind);
+bool parsePotentialKind(const char *name, PotentialKind &kind);
+
+// Command-line options shared by the executables:
+//   --potential NAME          built-in potential with default parameters
+//   --potential-file FILE     tabulated potential read by PotentialTable::load
+//   --potential-params A,B,C  overrides a, b, c (give after --potential)
+bool isPotentialOption(const std::string &option);
+bool applyPotentialOption(const std::string &option, const char *value,
+                          Potential &potential, std::string &error);
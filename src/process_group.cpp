@@ -0,0 +1,209 @@
+#include "process_group.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+
+#if defined(PI_HAVE_MPI)
+#include <mpi.h>
+#endif
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+ProcessGroup::ProcessGroup()
+: processRank(0), processCount(1), mpi(false) {}
+
+ProcessGroup::~ProcessGroup() {
+#if defined(PI_HAVE_MPI)
+    if (mpi)
+        MPI_Finalize();
+#endif
+#if !defined(_WIN32)
+    for (size_t i = 0; i < pipes.size(); i++) {
+        if (pipes[i] >= 0)
+            ::close(pipes[i]);
+    }
+#endif
+}
+
+bool ProcessGroup::fail(const std::string &message) {
+    lastError = message;
+    return false;
+}
+
+bool ProcessGroup::hasMpi() {
+#if defined(PI_HAVE_MPI)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ProcessGroup::startMpi(int &argc, char **&argv) {
+#if defined(PI_HAVE_MPI)
+    if (MPI_Init(&argc, &argv) != MPI_SUCCESS)
+        return fail("MPI_Init failed");
+    mpi = true;
+    MPI_Comm_rank(MPI_COMM_WORLD, &processRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &processCount);
+#else
+    (void)argc;
+    (void)argv;
+#endif
+    return true;
+}
+
+#if !defined(_WIN32)
+static bool writeAll(int fd, const void *data, size_t size) {
+    const char *p = (const char *)data;
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *data, size_t size) {
+    char *p = (char *)data;
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+#endif
+
+bool ProcessGroup::startLocal(int processes) {
+    if (processes <= 1)
+        return true;
+#if defined(_WIN32)
+    return fail("local worker processes need fork(); use an MPI build");
+#else
+    // Anything still buffered would be printed once per process.
+    std::cout.flush();
+    std::fflush(stdout);
+
+    pipes.assign(processes, -1);
+    for (int r = 1; r < processes; r++) {
+        int fds[2];
+        if (::pipe(fds) != 0)
+            return fail("cannot create a pipe for worker processes");
+
+        pid_t pid = ::fork();
+        if (pid < 0)
+            return fail("cannot fork worker processes");
+        if (pid == 0) {
+            ::close(fds[0]);
+            for (int i = 1; i < r; i++) {
+                ::close(pipes[i]);
+            }
+            pipes.assign(1, fds[1]);
+            children.clear();
+            processRank = r;
+            processCount = processes;
+            return true;
+        }
+        ::close(fds[1]);
+        pipes[r] = fds[0];
+        children.push_back((int)pid);
+    }
+    processCount = processes;
+    return true;
+#endif
+}
+
+bool ProcessGroup::send(const std::vector<unsigned char> &message) {
+    if (processRank == 0)
+        return fail("rank 0 does not send");
+#if defined(PI_HAVE_MPI)
+    if (mpi) {
+        if (MPI_Send(message.data(), (int)message.size(), MPI_BYTE, 0, 0,
+                     MPI_COMM_WORLD) != MPI_SUCCESS)
+            return fail("MPI_Send failed");
+        return true;
+    }
+#endif
+#if defined(_WIN32)
+    return fail("no transport");
+#else
+    uint64_t size = message.size();
+    if (!writeAll(pipes[0], &size, sizeof(size)) ||
+        !writeAll(pipes[0], message.data(), message.size()))
+        return fail("lost the connection to rank 0");
+    return true;
+#endif
+}
+
+bool ProcessGroup::receive(int from, std::vector<unsigned char> &message) {
+    if (processRank != 0 || from <= 0 || from >= processCount)
+        return fail("invalid receive");
+#if defined(PI_HAVE_MPI)
+    if (mpi) {
+        MPI_Status status;
+        int count = 0;
+        if (MPI_Probe(from, 0, MPI_COMM_WORLD, &status) != MPI_SUCCESS ||
+            MPI_Get_count(&status, MPI_BYTE, &count) != MPI_SUCCESS)
+            return fail("MPI_Probe failed");
+        message.resize(count);
+        if (MPI_Recv(message.data(), count, MPI_BYTE, from, 0, MPI_COMM_WORLD,
+                     MPI_STATUS_IGNORE) != MPI_SUCCESS)
+            return fail("MPI_Recv failed");
+        return true;
+    }
+#endif
+#if defined(_WIN32)
+    return fail("no transport");
+#else
+    uint64_t size = 0;
+    if (!readAll(pipes[from], &size, sizeof(size)))
+        return fail("worker " + std::to_string(from) + " exited early");
+    message.resize(size);
+    if (!readAll(pipes[from], message.data(), size))
+        return fail("worker " + std::to_string(from) + " exited early");
+    return true;
+#endif
+}
+
+bool ProcessGroup::finish() {
+#if defined(PI_HAVE_MPI)
+    if (mpi) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        mpi = false;
+        return true;
+    }
+#endif
+#if !defined(_WIN32)
+    for (size_t i = 0; i < pipes.size(); i++) {
+        if (pipes[i] >= 0)
+            ::close(pipes[i]);
+    }
+    pipes.clear();
+
+    bool ok = true;
+    for (size_t i = 0; i < children.size(); i++) {
+        int status = 0;
+        if (::waitpid((pid_t)children[i], &status, 0) < 0 ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            ok = false;
+    }
+    children.clear();
+    if (!ok)
+        return fail("a worker process failed");
+#endif
+    return true;
+}
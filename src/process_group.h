@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Processes that each run a share of one headless job. Rank 0 coordinates:
+// it does its own share too, then receives every other rank's partial
+// results and reduces them in rank order. Two transports:
+//   - local: startLocal(n) forks n - 1 workers on this machine, each talking
+//     to rank 0 over a pipe. Good for a single node, and for testing the
+//     reduction without a cluster (POSIX only);
+//   - MPI: startMpi() joins MPI_COMM_WORLD, one rank per process launched by
+//     mpirun. Only in builds configured with -DENABLE_MPI=ON.
+// Messages are opaque byte strings, normally a serialized CheckpointWriter.
+class ProcessGroup {
+public:
+    ProcessGroup();
+    ~ProcessGroup();
+
+    ProcessGroup(const ProcessGroup &) = delete;
+    ProcessGroup &operator=(const ProcessGroup &) = delete;
+
+    bool startLocal(int processes);
+    // A single rank when MPI support is not compiled in.
+    bool startMpi(int &argc, char **&argv);
+    static bool hasMpi();
+
+    int rank() const { return processRank; }
+    int size() const { return processCount; }
+    bool isCoordinator() const { return processRank == 0; }
+
+    // Non-zero ranks: queue a message for rank 0.
+    bool send(const std::vector<unsigned char> &message);
+    // Rank 0: the next message from `from`, in the order it was sent.
+    bool receive(int from, std::vector<unsigned char> &message);
+
+    // Rank 0 waits for the local workers to exit and fails if any of them
+    // did not succeed; MPI ranks synchronize and finalize.
+    bool finish();
+
+    const std::string &error() const { return lastError; }
+
+private:
+    bool fail(const std::string &message);
+
+    int processRank;
+    int processCount;
+    bool mpi;
+    // Local transport: rank 0 holds a read end per worker, a worker holds
+    // the write end of its own pipe.
+    std::vector<int> pipes;
+    std::vector<int> children;
+    std::string lastError;
+};
@@ -0,0 +1,190 @@
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+static int threadIndex() {
+    static std::atomic<int> nextIndex(0);
+    static thread_local int index = nextIndex++;
+    return index;
+}
+
+static double milliseconds(Profiler::Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+Profiler &Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+: active(false), requested(false), inFrame(false), frameAverageMs(0.0),
+tracing(false) {}
+
+void Profiler::setEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    requested = enabled;
+    active = requested || tracing;
+}
+
+Profiler::ZoneState &Profiler::zone(const char *name) {
+    for (size_t i = 0; i < zoneStates.size(); i++) {
+        if (zoneStates[i].name == name ||
+            std::strcmp(zoneStates[i].name, name) == 0)
+            return zoneStates[i];
+    }
+    ZoneState state = {name, 0.0, 0, 0.0, 0.0, 0};
+    zoneStates.push_back(state);
+    return zoneStates.back();
+}
+
+void Profiler::beginFrame() {
+    if (!enabled())
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    frameStart = Clock::now();
+    inFrame = true;
+}
+
+void Profiler::endFrame() {
+    if (!enabled())
+        return;
+    Clock::time_point end = Clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (inFrame) {
+        double ms = milliseconds(end - frameStart);
+        frameAverageMs =
+        frameAverageMs > 0.0 ? 0.9 * frameAverageMs + 0.1 * ms : ms;
+        if (tracing && events.size() < MAX_TRACE_EVENTS) {
+            TraceEvent event = {"frame",
+                                milliseconds(frameStart - traceStart) * 1e3,
+                                ms * 1e3, threadIndex()};
+            events.push_back(event);
+        }
+    }
+    inFrame = false;
+
+    for (size_t i = 0; i < zoneStates.size(); i++) {
+        ZoneState &z = zoneStates[i];
+        if (z.frameCalls == 0)
+            continue;
+        z.averageMs =
+        z.averageMs > 0.0 ? 0.9 * z.averageMs + 0.1 * z.frameMs : z.frameMs;
+        z.lastMs = z.frameMs;
+        z.lastCalls = z.frameCalls;
+        z.frameMs = 0.0;
+        z.frameCalls = 0;
+    }
+}
+
+void Profiler::record(const char *name, Clock::time_point start,
+                      Clock::time_point end) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ZoneState &z = zone(name);
+    z.frameMs += milliseconds(end - start);
+    z.frameCalls++;
+
+    if (tracing && events.size() < MAX_TRACE_EVENTS) {
+        TraceEvent event = {name, milliseconds(start - traceStart) * 1e3,
+                            milliseconds(end - start) * 1e3, threadIndex()};
+        events.push_back(event);
+    }
+}
+
+double Profiler::frameMs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return frameAverageMs;
+}
+
+std::vector<Profiler::Zone> Profiler::zones() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Zone> result;
+    for (size_t i = 0; i < zoneStates.size(); i++) {
+        const ZoneState &z = zoneStates[i];
+        Zone info = {z.name, z.lastMs, z.averageMs, z.lastCalls};
+        result.push_back(info);
+    }
+    return result;
+}
+
+std::string Profiler::summary(int numPaths) const {
+    std::vector<Zone> stages = zones();
+    double frame = frameMs();
+
+    char line[128];
+    std::string text;
+    std::snprintf(line, sizeof(line), "frame %.2f ms (%.0f fps)\n", frame,
+                  frame > 0.0 ? 1000.0 / frame : 0.0);
+    text += line;
+
+    for (size_t i = 0; i < stages.size(); i++) {
+        std::snprintf(line, sizeof(line), "%-10s %7.3f ms last, %7.3f avg, %d call(s)\n",
+                      stages[i].name, stages[i].lastMs, stages[i].averageMs,
+                      stages[i].calls);
+        text += line;
+        if (std::strcmp(stages[i].name, "generate") == 0 &&
+            stages[i].lastMs > 0.0) {
+            std::snprintf(line, sizeof(line), "%-10s %7.3g paths/s\n", "",
+                          numPaths * 1000.0 / stages[i].lastMs);
+            text += line;
+        }
+    }
+
+    if (isTracing()) {
+        std::snprintf(line, sizeof(line), "recording trace (%u events)\n",
+                      (unsigned)traceEventCount());
+        text += line;
+    }
+    return text;
+}
+
+void Profiler::startTrace() {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.clear();
+    traceStart = Clock::now();
+    tracing = true;
+    active = true;
+}
+
+void Profiler::stopTrace() {
+    std::lock_guard<std::mutex> lock(mutex);
+    tracing = false;
+    active = requested;
+}
+
+bool Profiler::isTracing() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tracing;
+}
+
+size_t Profiler::traceEventCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return events.size();
+}
+
+std::string Profiler::traceJson() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    out.precision(15);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent &e = events[i];
+        out << (i ? ",\n" : "\n") << "{\"name\":\"" << e.name
+        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+        << ",\"ts\":" << e.startUs << ",\"dur\":" << e.durationUs << "}";
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+bool Profiler::writeTrace(const std::string &path) const {
+    std::ofstream out(path.c_str());
+    if (!out)
+        return false;
+    out << traceJson();
+    return (bool)out;
+}
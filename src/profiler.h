@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide frame profiler. ScopedTimer zones are cheap no-ops while the
+// profiler is disabled; when enabled they feed per-frame stage totals for the
+// viewers' overlays and, while a trace is recording, Chrome trace events
+// (load the exported JSON in chrome://tracing or Perfetto).
+class Profiler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Zone {
+        const char *name;
+        double lastMs;    // total time in the most recent frame it ran,
+                          // summed over threads for zones inside parallelFor
+        double averageMs; // smoothed over the frames it ran in
+        int calls;        // calls in the most recent frame it ran
+    };
+
+    static Profiler &instance();
+
+    bool enabled() const { return active.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    void beginFrame();
+    void endFrame();
+
+    void record(const char *name, Clock::time_point start,
+                Clock::time_point end);
+
+    double frameMs() const;
+    std::vector<Zone> zones() const;
+
+    // Multi-line overlay text: frame time, stage breakdown and throughput of
+    // the last "generate" zone for an ensemble of numPaths paths.
+    std::string summary(int numPaths) const;
+
+    void startTrace();
+    void stopTrace();
+    bool isTracing() const;
+    size_t traceEventCount() const;
+    std::string traceJson() const;
+    bool writeTrace(const std::string &path) const;
+
+private:
+    Profiler();
+
+    struct ZoneState {
+        const char *name;
+        double frameMs;
+        int frameCalls;
+        double lastMs;
+        double averageMs;
+        int lastCalls;
+    };
+
+    struct TraceEvent {
+        const char *name;
+        double startUs;
+        double durationUs;
+        int thread;
+    };
+
+    static const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+    ZoneState &zone(const char *name);
+
+    std::atomic<bool> active;
+    bool requested;
+    mutable std::mutex mutex;
+    std::vector<ZoneState> zoneStates;
+    Clock::time_point frameStart;
+    bool inFrame;
+    double frameAverageMs;
+
+    bool tracing;
+    Clock::time_point traceStart;
+    std::vector<TraceEvent> events;
+};
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char *name)
+    : name(Profiler::instance().enabled() ? name : nullptr) {
+        if (this->name)
+            start = Profiler::Clock::now();
+    }
+
+    ~ScopedTimer() {
+        if (name)
+            Profiler::instance().record(name, start, Profiler::Clock::now());
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    const char *name;
+    Profiler::Clock::time_point start;
+};
@@ -0,0 +1,147 @@
+#include "random.h"
+
+#include <cstring>
+
+#include "action_kernel.h"
+
+static const uint32_t PHILOX_M0 = 0xD2511F53u;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57u;
+static const uint32_t PHILOX_W0 = 0x9E3779B9u;
+static const uint32_t PHILOX_W1 = 0xBB67AE85u;
+
+static inline void philoxRound(uint32_t &c0, uint32_t &c1, uint32_t &c2,
+                               uint32_t &c3, uint32_t k0, uint32_t k1) {
+    uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+    uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+    uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)p1;
+    c3 = (uint32_t)p0;
+    c0 = n0;
+    c2 = n2;
+}
+
+void philox4x32(const uint32_t key[2], const uint32_t counter[4],
+                uint32_t out[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        philoxRound(c0, c1, c2, c3, k0, k1);
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// A single block is one long multiply chain. Running LANES independent
+// blocks side by side lets the rounds overlap in the pipeline. The counters
+// are copied into locals so the compiler can keep them in registers instead
+// of assuming the four arrays alias.
+static const int LANES = 8;
+
+struct PhiloxLanes {
+    uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+};
+
+static void philoxLanes(const uint32_t key[2], PhiloxLanes &block) {
+    uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+    for (int i = 0; i < LANES; i++) {
+        c0[i] = block.c0[i];
+        c1[i] = block.c1[i];
+        c2[i] = block.c2[i];
+        c3[i] = block.c3[i];
+    }
+
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < LANES; i++) {
+            philoxRound(c0[i], c1[i], c2[i], c3[i], k0, k1);
+        }
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    for (int i = 0; i < LANES; i++) {
+        block.c0[i] = c0[i];
+        block.c1[i] = c1[i];
+        block.c2[i] = c2[i];
+        block.c3[i] = c3[i];
+    }
+}
+
+// SplitMix64's finalizer (Steele et al., OOPSLA 2014), a bijection on 64
+// bits.
+static uint64_t splitMix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// The low stream word goes into the counter and the rest into the key. For a
+// fixed high stream word the key is a bijection of the seed, so pairs that
+// differ only in the seed or in the low 32 stream bits never share a key and
+// counter. Pairs with different high words are mixed apart, not just xored,
+// so structured pairs no longer collide.
+PathNoise::PathNoise(uint64_t seed, uint64_t stream)
+: streamWord((uint32_t)stream) {
+    uint64_t k = splitMix64(seed ^ splitMix64(stream >> 32));
+    key[0] = (uint32_t)k;
+    key[1] = (uint32_t)(k >> 32);
+}
+
+void PathNoise::normals(uint64_t path, int count, double *out) {
+    const int pairs = (count + 1) / 2;
+    const size_t padded = (size_t)(pairs + LANES - 1) / LANES * LANES;
+    mantissa.resize(padded);
+    exponent.resize(padded);
+    turns.resize(padded);
+    cosPart.resize(pairs);
+    sinPart.resize(pairs);
+
+    // Integer half: one Philox block per pair. u1 = (a + 1/2) 2^-53 in (0, 1)
+    // is split exactly into mantissa and exponent from its bit pattern, so
+    // the kernel's log is a plain polynomial.
+    const double scale = 1.0 / 9007199254740992.0; // 2^-53
+    const uint32_t pathLo = (uint32_t)path, pathHi = (uint32_t)(path >> 32);
+    for (size_t k0 = 0; k0 < padded; k0 += LANES) {
+        PhiloxLanes block;
+        for (int i = 0; i < LANES; i++) {
+            block.c0[i] = (uint32_t)(k0 + i);
+            block.c1[i] = pathLo;
+            block.c2[i] = pathHi;
+            block.c3[i] = streamWord;
+        }
+        philoxLanes(key, block);
+
+        for (int i = 0; i < LANES; i++) {
+            uint64_t a = ((uint64_t)block.c0[i] << 32 | block.c1[i]) >> 11;
+            uint64_t b = ((uint64_t)block.c2[i] << 32 | block.c3[i]) >> 11;
+
+            double u1 = ((double)(int64_t)a + 0.5) * scale;
+            uint64_t bits;
+            std::memcpy(&bits, &u1, sizeof(bits));
+            int e = (int)(bits >> 52) - 1023;
+            bits = (bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull;
+            double m;
+            std::memcpy(&m, &bits, sizeof(m));
+            // m in [1, 2); fold the top half down to [sqrt(1/2), sqrt(2)).
+            bool high = m >= 1.41421356237309504880;
+            mantissa[k0 + i] = high ? 0.5 * m : m;
+            exponent[k0 + i] = high ? e + 1 : e;
+            turns[k0 + i] = (double)(int64_t)b * scale;
+        }
+    }
+
+    actionKernel().gaussianPairs(mantissa.data(), exponent.data(), turns.data(),
+                                 pairs, cosPart.data(), sinPart.data());
+
+    for (int k = 0; k < pairs; k++) {
+        out[2 * k] = cosPart[k];
+        if (2 * k + 1 < count)
+            out[2 * k + 1] = sinPart[k];
+    }
+}
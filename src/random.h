@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+// 3", SC11): ten multiply/xor rounds turn a 128-bit counter and a 64-bit key
+// into 128 random bits. There is no state to advance, so any draw can be
+// recomputed from its coordinates alone.
+void philox4x32(const uint32_t key[2], const uint32_t counter[4],
+                uint32_t out[4]);
+
+// Gaussian noise for path sampling, keyed by (seed, stream) and addressed by
+// (path, slice). Slices 2k and 2k + 1 share one Philox block and one
+// Box-Muller transform, run through the active SIMD kernel, so the deviate
+// for a given path and slice is the same whichever thread or batch asks for
+// it, and any single path can be regenerated on its own.
+class PathNoise {
+public:
+    PathNoise(uint64_t seed, uint64_t stream);
+
+    // out[s] = N(0, 1) deviate for slices s = 0 .. count - 1 of `path`.
+    void normals(uint64_t path, int count, double *out);
+
+private:
+    uint32_t key[2];
+    uint32_t streamWord;
+    std::vector<double> mantissa, exponent, turns, cosPart, sinPart;
+};
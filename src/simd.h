@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PI_HAVE_SSE2 1
+#endif
+
+#if defined(PI_HAVE_SSE2) || defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// Thin wrappers over one SIMD register of doubles. Every ISA translation unit
+// is compiled with its own flags and sees only the wrappers those flags
+// enable, so the definitions get internal linkage: the linker must never
+// merge an AVX-512 copy of an inline helper into the scalar code path.
+namespace {
+
+struct ScalarVec {
+    static const int WIDTH = 1;
+    double v;
+
+    ScalarVec() {}
+    explicit ScalarVec(double x) : v(x) {}
+
+    static ScalarVec load(const double *p) { return ScalarVec(*p); }
+    static ScalarVec loadu(const double *p) { return ScalarVec(*p); }
+    void store(double *p) const { *p = v; }
+    void storeu(double *p) const { *p = v; }
+    double sum() const { return v; }
+};
+
+inline ScalarVec operator+(const ScalarVec &a, const ScalarVec &b) {
+    return ScalarVec(a.v + b.v);
+}
+inline ScalarVec operator-(const ScalarVec &a, const ScalarVec &b) {
+    return ScalarVec(a.v - b.v);
+}
+inline ScalarVec operator*(const ScalarVec &a, const ScalarVec &b) {
+    return ScalarVec(a.v * b.v);
+}
+inline ScalarVec operator/(const ScalarVec &a, const ScalarVec &b) {
+    return ScalarVec(a.v / b.v);
+}
+inline ScalarVec sqrt(const ScalarVec &a) { return ScalarVec(std::sqrt(a.v)); }
+
+#if defined(PI_HAVE_SSE2)
+struct Sse2Vec {
+    static const int WIDTH = 2;
+    __m128d v;
+
+    Sse2Vec() {}
+    explicit Sse2Vec(double x) : v(_mm_set1_pd(x)) {}
+    Sse2Vec(__m128d x) : v(x) {}
+
+    static Sse2Vec load(const double *p) { return _mm_load_pd(p); }
+    static Sse2Vec loadu(const double *p) { return _mm_loadu_pd(p); }
+    void store(double *p) const { _mm_store_pd(p, v); }
+    void storeu(double *p) const { _mm_storeu_pd(p, v); }
+    double sum() const {
+        return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+    }
+};
+
+inline Sse2Vec operator+(const Sse2Vec &a, const Sse2Vec &b) {
+    return _mm_add_pd(a.v, b.v);
+}
+inline Sse2Vec operator-(const Sse2Vec &a, const Sse2Vec &b) {
+    return _mm_sub_pd(a.v, b.v);
+}
+inline Sse2Vec operator*(const Sse2Vec &a, const Sse2Vec &b) {
+    return _mm_mul_pd(a.v, b.v);
+}
+inline Sse2Vec operator/(const Sse2Vec &a, const Sse2Vec &b) {
+    return _mm_div_pd(a.v, b.v);
+}
+inline Sse2Vec sqrt(const Sse2Vec &a) { return _mm_sqrt_pd(a.v); }
+#endif
+
+#if defined(__AVX2__)
+struct Avx2Vec {
+    static const int WIDTH = 4;
+    __m256d v;
+
+    Avx2Vec() {}
+    explicit Avx2Vec(double x) : v(_mm256_set1_pd(x)) {}
+    Avx2Vec(__m256d x) : v(x) {}
+
+    static Avx2Vec load(const double *p) { return _mm256_load_pd(p); }
+    static Avx2Vec loadu(const double *p) { return _mm256_loadu_pd(p); }
+    void store(double *p) const { _mm256_store_pd(p, v); }
+    void storeu(double *p) const { _mm256_storeu_pd(p, v); }
+    double sum() const {
+        __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v),
+                                  _mm256_extractf128_pd(v, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+    }
+};
+
+inline Avx2Vec operator+(const Avx2Vec &a, const Avx2Vec &b) {
+    return _mm256_add_pd(a.v, b.v);
+}
+inline Avx2Vec operator-(const Avx2Vec &a, const Avx2Vec &b) {
+    return _mm256_sub_pd(a.v, b.v);
+}
+inline Avx2Vec operator*(const Avx2Vec &a, const Avx2Vec &b) {
+    return _mm256_mul_pd(a.v, b.v);
+}
+inline Avx2Vec operator/(const Avx2Vec &a, const Avx2Vec &b) {
+    return _mm256_div_pd(a.v, b.v);
+}
+inline Avx2Vec sqrt(const Avx2Vec &a) { return _mm256_sqrt_pd(a.v); }
+#endif
+
+#if defined(__AVX512F__)
+struct Avx512Vec {
+    static const int WIDTH = 8;
+    __m512d v;
+
+    Avx512Vec() {}
+    explicit Avx512Vec(double x) : v(_mm512_set1_pd(x)) {}
+    Avx512Vec(__m512d x) : v(x) {}
+
+    static Avx512Vec load(const double *p) { return _mm512_load_pd(p); }
+    static Avx512Vec loadu(const double *p) { return _mm512_loadu_pd(p); }
+    void store(double *p) const { _mm512_store_pd(p, v); }
+    void storeu(double *p) const { _mm512_storeu_pd(p, v); }
+    double sum() const { return _mm512_reduce_add_pd(v); }
+};
+
+inline Avx512Vec operator+(const Avx512Vec &a, const Avx512Vec &b) {
+    return _mm512_add_pd(a.v, b.v);
+}
+inline Avx512Vec operator-(const Avx512Vec &a, const Avx512Vec &b) {
+    return _mm512_sub_pd(a.v, b.v);
+}
+inline Avx512Vec operator*(const Avx512Vec &a, const Avx512Vec &b) {
+    return _mm512_mul_pd(a.v, b.v);
+}
+inline Avx512Vec operator/(const Avx512Vec &a, const Avx512Vec &b) {
+    return _mm512_div_pd(a.v, b.v);
+}
+inline Avx512Vec sqrt(const Avx512Vec &a) { return _mm512_sqrt_pd(a.v); }
+#endif
+
+} // namespace
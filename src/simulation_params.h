@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+#include "potential.h"
+
+struct SimulationParams {
+    int numPaths;
+    int timeSteps;
+    double hbar;
+    double mass;
+    double dt;
+    double x0;
+    double xf;
+    double sigma;
+    uint64_t seed;
+    Potential potential;
+    // Weight paths by exp(-S_E/hbar) in imaginary time instead of the
+    // oscillating phase exp(-iS/hbar).
+    bool euclidean;
+
+    SimulationParams()
+    : numPaths(1000), timeSteps(50), hbar(1.0), mass(1.0), dt(0.1), x0(-2.0),
+    xf(2.0), sigma(0.5), seed(42), euclidean(false) {}
+};
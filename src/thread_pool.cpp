@@ -0,0 +1,88 @@
+#include "thread_pool.h"
+
+int ThreadPool::defaultThreadCount() {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    return 1;
+#else
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+ThreadPool::ThreadPool(int numThreads)
+: job(nullptr), jobTasks(0), nextTask(0), busyWorkers(0), jobId(0),
+stopping(false) {
+    if (numThreads <= 0)
+        numThreads = defaultThreadCount();
+
+    for (int i = 1; i < numThreads; i++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::runTasks() {
+    for (;;) {
+        int task = nextTask.fetch_add(1);
+        if (task >= jobTasks)
+            break;
+        (*job)(task);
+    }
+}
+
+void ThreadPool::parallelFor(int numTasks,
+                             const std::function<void(int)> &task) {
+    if (workers.empty() || numTasks <= 1) {
+        for (int i = 0; i < numTasks; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &task;
+        jobTasks = numTasks;
+        nextTask = 0;
+        busyWorkers = (int)workers.size();
+        jobId++;
+    }
+    wake.notify_all();
+
+    runTasks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busyWorkers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seenJob = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seenJob] { return stopping || jobId != seenJob; });
+            if (stopping)
+                return;
+            seenJob = jobId;
+        }
+
+        runTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers--;
+        }
+        finished.notify_one();
+    }
+}
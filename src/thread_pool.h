@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers that run numbered tasks; the calling thread takes part
+// in every parallelFor, so a pool of size 1 spawns no threads at all.
+class ThreadPool {
+public:
+    explicit ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const { return (int)workers.size() + 1; }
+
+    void parallelFor(int numTasks, const std::function<void(int)> &task);
+
+    static int defaultThreadCount();
+
+private:
+    void workerLoop();
+    void runTasks();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    const std::function<void(int)> *job;
+    int jobTasks;
+    std::atomic<int> nextTask;
+    int busyWorkers;
+    uint64_t jobId;
+    bool stopping;
+};
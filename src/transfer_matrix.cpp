@@ -0,0 +1,171 @@
+#include "transfer_matrix.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+
+void multiplyAddBlocked(const double *a, const double *b, double *c, int n,
+                        double sign, ThreadPool &pool) {
+    const int T = TransferMatrix::TILE;
+    const int tiles = (n + T - 1) / T;
+
+    pool.parallelFor(tiles, [&](int ti) {
+        const int i0 = ti * T, i1 = std::min(i0 + T, n);
+        for (int k0 = 0; k0 < n; k0 += T) {
+            const int k1 = std::min(k0 + T, n);
+            for (int j0 = 0; j0 < n; j0 += T) {
+                const int j1 = std::min(j0 + T, n);
+                for (int i = i0; i < i1; i++) {
+                    double *row = c + (size_t)i * n;
+                    for (int k = k0; k < k1; k++) {
+                        const double aik = sign * a[(size_t)i * n + k];
+                        const double *brow = b + (size_t)k * n;
+                        for (int j = j0; j < j1; j++) {
+                            row[j] += aik * brow[j];
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+TransferMatrix::TransferMatrix(int latticeSize, double dx)
+: n(latticeSize), dx(dx), mode(EUCLIDEAN), hbar(1.0), dt(1.0) {}
+
+int TransferMatrix::siteOf(double x) const {
+    int i = (int)std::floor(x / dx + 0.5 * (n - 1) + 0.5);
+    return std::max(0, std::min(n - 1, i));
+}
+
+void TransferMatrix::build(const SimulationParams &params, Mode mode) {
+    this->mode = mode;
+    hbar = params.hbar;
+    dt = params.dt;
+
+    const size_t cells = (size_t)n * n;
+    stepRe.assign(cells, 0.0);
+    stepIm.assign(mode == REAL_TIME ? cells : 0, 0.0);
+    kernelRe.clear();
+    kernelIm.clear();
+
+    std::vector<double> V(n);
+    for (int i = 0; i < n; i++) {
+        V[i] = params.potential.value(position(i));
+    }
+
+    const double kinetic = 0.5 * params.mass / dt;
+    const double norm = dx * std::sqrt(params.mass / (2.0 * PI * hbar * dt));
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double d = position(i) - position(j);
+            double kineticTerm = kinetic * d * d;
+            double potentialTerm = 0.5 * dt * (V[i] + V[j]);
+            size_t ij = (size_t)i * n + j;
+            if (mode == EUCLIDEAN) {
+                stepRe[ij] = norm * std::exp(-(kineticTerm + potentialTerm) / hbar);
+            } else {
+                // 1/sqrt(i) contributes a phase of -pi/4.
+                double phase = (kineticTerm - potentialTerm) / hbar - 0.25 * PI;
+                stepRe[ij] = norm * std::cos(phase);
+                stepIm[ij] = norm * std::sin(phase);
+            }
+        }
+    }
+}
+
+void TransferMatrix::propagate(int steps, ThreadPool &pool) {
+    const size_t cells = (size_t)n * n;
+    const bool complex = mode == REAL_TIME;
+
+    std::vector<double> baseRe(stepRe), baseIm(stepIm);
+    kernelRe.assign(cells, 0.0);
+    kernelIm.assign(complex ? cells : 0, 0.0);
+    for (int i = 0; i < n; i++) {
+        kernelRe[(size_t)i * n + i] = 1.0;
+    }
+
+    std::vector<double> outRe(cells), outIm(complex ? cells : 0);
+
+    // out = x * y, with (xr + i xi)(yr + i yi) split into four real products.
+    auto multiply = [&](const std::vector<double> &xr, const std::vector<double> &xi,
+                        const std::vector<double> &yr, const std::vector<double> &yi) {
+        std::fill(outRe.begin(), outRe.end(), 0.0);
+        multiplyAddBlocked(xr.data(), yr.data(), outRe.data(), n, 1.0, pool);
+        if (!complex)
+            return;
+        std::fill(outIm.begin(), outIm.end(), 0.0);
+        multiplyAddBlocked(xi.data(), yi.data(), outRe.data(), n, -1.0, pool);
+        multiplyAddBlocked(xr.data(), yi.data(), outIm.data(), n, 1.0, pool);
+        multiplyAddBlocked(xi.data(), yr.data(), outIm.data(), n, 1.0, pool);
+    };
+
+    for (int remaining = steps; remaining > 0; remaining >>= 1) {
+        if (remaining & 1) {
+            multiply(kernelRe, kernelIm, baseRe, baseIm);
+            kernelRe.swap(outRe);
+            kernelIm.swap(outIm);
+        }
+        if (remaining > 1) {
+            multiply(baseRe, baseIm, baseRe, baseIm);
+            baseRe.swap(outRe);
+            baseIm.swap(outIm);
+        }
+    }
+}
+
+std::complex<double> TransferMatrix::kernelAt(int i, int j) const {
+    size_t ij = (size_t)i * n + j;
+    double im = kernelIm.empty() ? 0.0 : kernelIm[ij];
+    return std::complex<double>(kernelRe[ij], im) / dx;
+}
+
+double TransferMatrix::groundState(std::vector<double> &density,
+                                   int maxIterations, double tolerance) const {
+    std::vector<double> v(n, 1.0 / std::sqrt((double)n)), w(n);
+    double lambda = 0.0;
+
+    for (int iteration = 0; iteration < maxIterations; iteration++) {
+        for (int i = 0; i < n; i++) {
+            const double *row = &stepRe[(size_t)i * n];
+            double sum = 0.0;
+            for (int j = 0; j < n; j++) {
+                sum += row[j] * v[j];
+            }
+            w[i] = sum;
+        }
+
+        double norm = 0.0;
+        for (int i = 0; i < n; i++) {
+            norm += w[i] * w[i];
+        }
+        norm = std::sqrt(norm);
+
+        double change = 0.0;
+        for (int i = 0; i < n; i++) {
+            double next = w[i] / norm;
+            change = std::max(change, std::fabs(next - v[i]));
+            v[i] = next;
+        }
+        lambda = norm;
+        if (change < tolerance)
+            break;
+    }
+
+    density.resize(n);
+    for (int i = 0; i < n; i++) {
+        density[i] = v[i] * v[i] / dx;
+    }
+    return -hbar * std::log(lambda) / dt;
+}
+
+double TransferMatrix::meanX2(const std::vector<double> &density) const {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        double x = position(i);
+        sum += x * x * density[i] * dx;
+    }
+    return sum;
+}
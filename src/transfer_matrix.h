@@ -0,0 +1,76 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+#include "simulation_params.h"
+#include "thread_pool.h"
+
+// Deterministic counterpart of the path samplers. x is discretized on
+// latticeSize sites spaced dx apart and centred on 0 (hard walls beyond the
+// ends), and the short-time kernel over one step dt becomes a dense matrix:
+//   imaginary time  T_ij = dx sqrt(m / (2 pi hbar dt))
+//                          exp(-[m (x_i - x_j)^2 / (2 dt) + dt (V_i + V_j) / 2] / hbar)
+//   real time       T_ij = dx sqrt(m / (2 pi i hbar dt))
+//                          exp(+i [m (x_i - x_j)^2 / (2 dt) - dt (V_i + V_j) / 2] / hbar)
+// The real-time kernel is the physical propagator <x_f| exp(-iHT/hbar) |x_0>,
+// but only while the grid resolves the kinetic phase (see phaseStep); past
+// that the oscillating sums alias and the squared matrix blows up.
+// Raising T to timeSteps by repeated squaring gives the full kernel in
+// O(n^3 log timeSteps).
+class TransferMatrix {
+public:
+    enum Mode { EUCLIDEAN, REAL_TIME };
+
+    // Edge length of the square tiles used by the blocked multiply.
+    static const int TILE = 64;
+
+    TransferMatrix(int latticeSize, double dx);
+
+    int size() const { return n; }
+    double spacing() const { return dx; }
+    double position(int i) const { return (i - 0.5 * (n - 1)) * dx; }
+    // Nearest lattice site, clamped to the grid.
+    int siteOf(double x) const;
+
+    // Largest kinetic phase change between neighbouring sites across the
+    // grid, m (n - 1) dx^2 / (hbar dt). Real-time kernels need it below pi.
+    double phaseStep(const SimulationParams &params) const {
+        return params.mass * (n - 1) * dx * dx / (params.hbar * params.dt);
+    }
+
+    // Builds the one-step matrix for params (mass, hbar, dt, potential).
+    void build(const SimulationParams &params, Mode mode);
+
+    // kernel = step^steps, by squaring; parallel over row tiles.
+    void propagate(int steps, ThreadPool &pool);
+
+    // Kernel density K(x_i, x_j) = kernel_ij / dx after propagate().
+    std::complex<double> kernelAt(int i, int j) const;
+    std::complex<double> propagator(double xf, double x0) const {
+        return kernelAt(siteOf(xf), siteOf(x0));
+    }
+
+    // Euclidean mode only: largest eigenvalue of the one-step matrix by
+    // power iteration, E0 = -hbar ln(lambda) / dt. density receives
+    // |psi_0(x_i)|^2 normalized so that sum density * dx = 1.
+    double groundState(std::vector<double> &density, int maxIterations = 100000,
+                       double tolerance = 1e-13) const;
+
+    // Expectation of f(x) = x^2 in a density returned by groundState.
+    double meanX2(const std::vector<double> &density) const;
+
+private:
+    int n;
+    double dx;
+    Mode mode;
+    double hbar;
+    double dt;
+    std::vector<double> stepRe, stepIm;
+    std::vector<double> kernelRe, kernelIm;
+};
+
+// C += sign * A * B for row-major n x n matrices, tiled for cache reuse and
+// split over row tiles on the pool.
+void multiplyAddBlocked(const double *a, const double *b, double *c, int n,
+                        double sign, ThreadPool &pool);
@@ -28,11 +28,13 @@ fi
 
 echo "Compiling 1D Quantum Path Integral Simulation for web..."
 
-emcc ../src/main_web.cpp -o ${OUTPUT_NAME}.html \
+CORE_SOURCES="../src/action_kernel.cpp ../src/action_kernel_sse2.cpp ../src/action_kernel_avx2.cpp ../src/action_kernel_avx512.cpp ../src/background_generator.cpp ../src/path_generator.cpp ../src/path_geometry.cpp ../src/potential.cpp ../src/profiler.cpp ../src/random.cpp ../src/thread_pool.cpp"
+
+emcc ../src/main_web.cpp ${CORE_SOURCES} -o ${OUTPUT_NAME}.html \
   -s USE_WEBGL2=1 \
   -s ALLOW_MEMORY_GROWTH=1 \
-  -s EXPORTED_FUNCTIONS="['_main','_setLatticeSize','_setTimeSteps','_setNumPaths','_setHbar','_setMass','_setDt','_setDx','_regeneratePaths']" \
-  -s EXPORTED_RUNTIME_METHODS="['ccall','cwrap']" \
+  -s EXPORTED_FUNCTIONS="['_main','_setLatticeSize','_setTimeSteps','_setNumPaths','_setHbar','_setMass','_setDt','_setDx','_regeneratePaths','_setPotential','_setPotentialParams','_setPotentialTable','_malloc','_free','_setProfilerOverlay','_toggleTrace','_setEuclidean']" \
+  -s EXPORTED_RUNTIME_METHODS="['ccall','cwrap','UTF8ToString']" \
   --shell-file ${SHELL_FILE} \
   -O2 -std=c++11
 